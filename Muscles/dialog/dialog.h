@@ -6,6 +6,13 @@
 
 struct Search_Menu;
 
+#define MAX_POINTER_REF_ITEMS 20
+
+// Fills a right-click menu with what points into [start, end), where the first item says how many pointers there are and the rest are their addresses.
+// While the pointer index is still being built, the menu just says so.
+// 'action' gets called with the item's index in ws.rclick_menu.hl, which is one more than its index in 'refs'.
+void make_pointer_refs_menu(Source *source, u64 start, u64 end, std::vector<u64>& refs, std::vector<std::string>& labels, std::vector<Menu_Item>& items, void (*action)(Workspace&, Box*));
+
 template<class UI>
 void populate_object_table(UI *ui, std::vector<Struct*>& structs, String_Vector& name_vector) {
 	ui->object.data->clear_data();
@@ -128,6 +135,8 @@ struct View_Source : Box {
 	void handle_zoom(Workspace& ws, float new_scale) override;
 	void on_close() override;
 
+	void prepare_rclick_menu(Context_Menu& menu, Camera& view, Point& cursor) override;
+
 	void refresh_region_list(Point *cursor);
 	void update_regions_table();
 	void goto_address(u64 address);
@@ -161,6 +170,9 @@ struct View_Source : Box {
 	u64 selected_region = 0;
 	int goto_digits = 2;
 	bool needs_region_update = true;
+
+	std::vector<u64> refs;
+	std::vector<std::string> ref_labels;
 };
 
 struct Edit_Structs : Box {
@@ -198,9 +210,11 @@ struct View_Object : Box {
 	void refresh(Point *cursor) override;
 	void handle_zoom(Workspace& ws, float new_scale) override;
 	void on_close() override;
+	void prepare_rclick_menu(Context_Menu& menu, Camera& view, Point& cursor) override;
 
 	float get_edit_height(float scale);
 	void update_hide_meta_button(float scale);
+	void update_heap_label(u64 address);
 	void select_view_type(bool all);
 
 	Image cross;
@@ -214,6 +228,7 @@ struct View_Object : Box {
 	Edit_Box source_edit;
 	Drop_Down source_dd;
 	Edit_Box addr_edit;
+	Label heap_label;
 	Button hide_meta;
 	Data_View object;
 	Scroll hscroll;
@@ -233,6 +248,12 @@ struct View_Object : Box {
 	Source *source = nullptr;
 	int span_idx = -1;
 
+	// only opened once the address is a pointer path, which has to be followed before the span can be read
+	SOURCE_HANDLE path_handle = (SOURCE_HANDLE)0;
+
+	std::vector<u64> refs;
+	std::vector<std::string> ref_labels;
+
 	float meta_btn_width = 20;
 	float meta_btn_height = 20;
 	bool meta_hidden = false;
@@ -265,6 +286,25 @@ struct View_Definitions : Box {
 	Arena arena;
 };
 
+#define LIVE_VALUE_LEN 32
+
+#define DEFAULT_PREFETCH_ROWS 64
+#define MAX_PREFETCH_ROWS     4096
+
+#define DEFAULT_POINTER_DEPTH  "4"
+#define DEFAULT_POINTER_OFFSET "0x400"
+
+#define DEFAULT_GROUP_WINDOW "64"
+
+// What's been seen at one of the results near the visible rows of a search box
+struct Live_Value {
+	u64 address;
+	u8 current[8];
+	bool seen;
+	char value[LIVE_VALUE_LEN];
+	char previous[LIVE_VALUE_LEN]; // what it was before it last changed
+};
+
 struct Search_Menu : Box {
 	static const BoxType box_type_meta = BoxSearch;
 	Search_Menu(Workspace& ws, MenuType mtype);
@@ -279,6 +319,14 @@ struct Search_Menu : Box {
 
 	bool prepare_object_params();
 	bool prepare_value_param();
+	bool prepare_pattern_param();
+	bool prepare_text_param();
+	bool prepare_pointer_param();
+	bool prepare_group_param();
+
+	void fill_results();
+	void update_live_values();
+	void release_live_values();
 
 	Image cross;
 	Image maxm;
@@ -298,6 +346,7 @@ struct Search_Menu : Box {
 
 	Label align_lbl;
 	Edit_Box align_edit;
+	Checkbox resident_cb;
 
 	Label type_lbl;
 	Edit_Box type_edit;
@@ -310,6 +359,33 @@ struct Search_Menu : Box {
 	Edit_Box value1_edit;
 	Edit_Box value2_edit;
 
+	Label depth_lbl;
+	Edit_Box depth_edit;
+	Label offset_lbl;
+	Edit_Box offset_edit;
+
+	Label window_lbl;
+	Edit_Box window_edit;
+	Checkbox order_cb;
+
+	Checkbox case_cb;
+	Checkbox writes_cb;
+	Checkbox heap_cb;
+
+	Edit_Box file_edit;
+	Button resume_btn;
+	std::string attached_path;
+
+	Drop_Down combine_dd;
+	Edit_Box distance_edit;
+	Drop_Down target_dd;
+	Button combine_btn;
+
+	// the other search boxes whose results this one's can be combined with, in the same order as target_dd
+	std::vector<Search_Menu*> targets;
+	std::vector<std::string> target_names;
+	int search_id = 0;
+
 	Label object_lbl;
 	Data_View object;
 	Scroll object_scroll;
@@ -317,7 +393,7 @@ struct Search_Menu : Box {
 
 	Table object_table;
 
-	//Progress_Bar progress_bar;
+	Progress_Bar progress_bar;
 
 	Button search_btn;
 	Button cancel_btn;
@@ -331,6 +407,15 @@ struct Search_Menu : Box {
 	Data_View results;
 	Scroll results_scroll;
 
+	Label prefetch_lbl;
+	Edit_Box prefetch_edit;
+
+	// The spans line up with live_values, which are for the rows from live_start onwards
+	Source *live_source = nullptr;
+	std::vector<int> value_spans;
+	std::vector<Live_Value> live_values;
+	int live_start = 0;
+
 	Font *label_font = nullptr;
 	Font *dd_font = nullptr;
 	Font *table_font = nullptr;
@@ -343,12 +428,46 @@ struct Search_Menu : Box {
 
 	std::vector<char*> method_options = {
 		(char*)"Equals",
-		(char*)"Range"
+		(char*)"Range",
+		(char*)"Unknown",
+		(char*)"Changed",
+		(char*)"Unchanged",
+		(char*)"Increased",
+		(char*)"Decreased",
+		(char*)"Changed By",
+		(char*)"Within",
+		(char*)"Rounds To",
+		(char*)"Truncates To"
+	};
+
+	// object searches can only look for known values, so these don't line up with the METHOD_ constants
+	std::vector<char*> object_method_options = {
+		(char*)"Equals",
+		(char*)"Range",
+		(char*)"Within",
+		(char*)"Rounds To",
+		(char*)"Truncates To"
+	};
+
+	// in the same order as the COMBINE_ constants
+	std::vector<char*> combine_options = {
+		(char*)"Intersect",
+		(char*)"Union",
+		(char*)"Difference",
+		(char*)"Within"
+	};
+
+	// in the same order as TEXT_ANY, TEXT_UTF8 and TEXT_UTF16LE
+	std::vector<char*> text_encoding_options = {
+		(char*)"Any",
+		(char*)"ASCII / UTF-8",
+		(char*)"UTF-16LE"
 	};
 
 	Search_Parameter *params_pool = nullptr;
 
 	Search search;
+	Search_Session *session = nullptr;
 	Source *source = nullptr;
 	Struct *record = nullptr;
 };
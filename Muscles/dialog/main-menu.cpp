@@ -138,11 +138,12 @@ void sources_main_menu_handler(UI_Element *elem, Camera& view, bool dbl_click) {
 
 void search_main_menu_handler(UI_Element *elem, Camera& view, bool dbl_click) {
 	auto dd = dynamic_cast<Drop_Down*>(elem);
-	if (dd->hl < 0 || dd->hl > 1)
+	if (dd->hl < 0 || dd->hl > 5)
 		return;
 
 	Workspace *ws = dd->parent->parent;
-	ws->make_box<Search_Menu>(dd->hl == 0 ? MenuValue : MenuObject);
+	MenuType types[] = {MenuValue, MenuObject, MenuPattern, MenuText, MenuPointer, MenuGroup};
+	ws->make_box<Search_Menu>(types[dd->hl]);
 }
 
 void edit_main_menu_handler(UI_Element *elem, Camera& view, bool dbl_click) {
@@ -264,7 +265,11 @@ Main_Menu::Main_Menu(Workspace& ws, MenuType mtype) {
 	search_dd.width = 150;
 	search_dd.content = {
 		(char*)"Single Value",
-		(char*)"Object"
+		(char*)"Object",
+		(char*)"Byte Pattern",
+		(char*)"Text",
+		(char*)"Pointer Path",
+		(char*)"Value Group"
 	};
 
 	sources_view.show_column_names = true;
@@ -2,6 +2,9 @@
 #include "../ui.h"
 #include "dialog.h"
 
+#include <algorithm>
+#include <charconv>
+
 #define LABEL_HEIGHT_FACTOR 1.2f
 #define EDIT_HEIGHT_FACTOR  1.4f
 
@@ -116,12 +119,19 @@ void Search_Menu::update_ui(Camera& view) {
 
 		align_edit.pos = {
 			.x = align_lbl.pos.x,
-			.y = y + (total_addr_edit_h - edit_h) / 2,
+			.y = y,
 			.w = align_w,
-			.h = edit_h
+			.h = addr_edit_h
+		};
+
+		resident_cb.pos = {
+			.x = align_lbl.pos.x,
+			.y = end_addr_edit.pos.y,
+			.w = align_w,
+			.h = addr_edit_h
 		};
 
-		align_lbl.pos.y = align_edit.pos.y - border - edit_h;
+		align_lbl.pos.y = addr_lbl.pos.y;
 
 		y += total_addr_edit_h + 2*border;
 
@@ -168,6 +178,150 @@ void Search_Menu::update_ui(Camera& view) {
 				.h = object_div.breadth
 			};
 		}
+		else if (menu_type == MenuPattern) {
+			value_lbl.pos = {
+				.x = start_x,
+				.y = y,
+				.w = 100,
+				.h = label_h
+			};
+			y += value_lbl.pos.h + border;
+
+			value1_edit.pos = {
+				.x = start_x,
+				.y = y,
+				.w = total_w,
+				.h = edit_h
+			};
+			y += value1_edit.pos.h;
+		}
+		else if (menu_type == MenuPointer) {
+			value_lbl.pos = {
+				.x = start_x,
+				.y = y,
+				.w = 100,
+				.h = label_h
+			};
+			y += value_lbl.pos.h + border;
+
+			value1_edit.pos = {
+				.x = start_x,
+				.y = y,
+				.w = total_w,
+				.h = edit_h
+			};
+			y += value1_edit.pos.h + 2*border;
+
+			float limit_w = (box.w - 3*start_x) / 2;
+
+			depth_lbl.pos = {
+				.x = start_x,
+				.y = y,
+				.w = limit_w,
+				.h = label_h
+			};
+			offset_lbl.pos = {
+				.x = 2*start_x + limit_w,
+				.y = y,
+				.w = limit_w,
+				.h = label_h
+			};
+			y += depth_lbl.pos.h + border;
+
+			depth_edit.pos = {
+				.x = start_x,
+				.y = y,
+				.w = limit_w,
+				.h = edit_h
+			};
+			offset_edit.pos = {
+				.x = offset_lbl.pos.x,
+				.y = y,
+				.w = limit_w,
+				.h = edit_h
+			};
+			y += depth_edit.pos.h;
+		}
+		else if (menu_type == MenuGroup) {
+			value_lbl.pos = {
+				.x = start_x,
+				.y = y,
+				.w = 100,
+				.h = label_h
+			};
+			y += value_lbl.pos.h + border;
+
+			value1_edit.pos = {
+				.x = start_x,
+				.y = y,
+				.w = total_w,
+				.h = edit_h
+			};
+			y += value1_edit.pos.h + 2*border;
+
+			window_lbl.pos = {
+				.x = start_x,
+				.y = y,
+				.w = 120,
+				.h = label_h
+			};
+			y += window_lbl.pos.h + border;
+
+			window_edit.pos = {
+				.x = start_x,
+				.y = y,
+				.w = window_lbl.pos.w,
+				.h = edit_h
+			};
+
+			order_cb.pos = {
+				.x = window_edit.pos.x + window_edit.pos.w + 2*start_x,
+				.y = y,
+				.w = 16 * order_cb.font->render.digit_width() / view.scale,
+				.h = edit_h
+			};
+			y += window_edit.pos.h;
+		}
+		else if (menu_type == MenuText) {
+			value_lbl.pos = {
+				.x = start_x,
+				.y = y,
+				.w = 100,
+				.h = label_h
+			};
+			y += value_lbl.pos.h + border;
+
+			value1_edit.pos = {
+				.x = start_x,
+				.y = y,
+				.w = total_w,
+				.h = edit_h
+			};
+			y += value1_edit.pos.h + 2*border;
+
+			method_lbl.pos = {
+				.x = start_x,
+				.y = y,
+				.w = 120,
+				.h = label_h
+			};
+			y += method_lbl.pos.h + border;
+
+			method_dd.pos = {
+				.x = start_x,
+				.y = y,
+				.w = method_lbl.pos.w,
+				.h = edit_h
+			};
+
+			case_cb.pos = {
+				.x = method_dd.pos.x + method_dd.pos.w + 2*start_x,
+				.y = y,
+				.w = 14 * case_cb.font->render.digit_width() / view.scale,
+				.h = edit_h
+			};
+			y += method_dd.pos.h;
+		}
 		else {
 			type_lbl.pos = {
 				.x = start_x,
@@ -221,13 +375,83 @@ void Search_Menu::update_ui(Camera& view) {
 				.w = value_w,
 				.h = edit_h
 			};
-			y += value2_edit.pos.h;
+			y += value2_edit.pos.h + border;
+
+			writes_cb.pos = {
+				.x = start_x,
+				.y = y,
+				.w = total_w,
+				.h = edit_h
+			};
+			y += writes_cb.pos.h + border;
+
+			heap_cb.pos = {
+				.x = start_x,
+				.y = y,
+				.w = total_w,
+				.h = edit_h
+			};
+			y += heap_cb.pos.h + border;
+
+			float resume_w = resume_btn.width;
+			file_edit.pos = {
+				.x = start_x,
+				.y = y,
+				.w = total_w - resume_w - start_x,
+				.h = edit_h
+			};
+			resume_btn.pos = {
+				.x = start_x + total_w - resume_w,
+				.y = y,
+				.w = resume_w,
+				.h = edit_h
+			};
+			y += file_edit.pos.h;
 		}
+
+		y += 2*border;
+
+		float combine_w = 100;
+		float distance_w = 60;
+
+		combine_dd.pos = {
+			.x = start_x,
+			.y = y,
+			.w = combine_w,
+			.h = edit_h
+		};
+		distance_edit.pos = {
+			.x = start_x + combine_w + start_x,
+			.y = y,
+			.w = distance_w,
+			.h = edit_h
+		};
+		combine_btn.pos = {
+			.x = start_x + total_w - combine_btn.width,
+			.y = y,
+			.w = combine_btn.width,
+			.h = edit_h
+		};
+
+		float target_x = distance_edit.pos.x + distance_w + start_x;
+		target_dd.pos = {
+			.x = target_x,
+			.y = y,
+			.w = combine_btn.pos.x - start_x - target_x,
+			.h = edit_h
+		};
+		y += combine_dd.pos.h;
 	}
 
-	y += 5*border;
+	y += 2*border;
 
-	// progress_bar.pos = {...
+	progress_bar.pos = {
+		.x = start_x,
+		.y = y,
+		.w = box.w - 2*start_x,
+		.h = border
+	};
+	y += progress_bar.pos.h + 2*border;
 
 	float total_btn_w = search_btn.width + start_x + cancel_btn.width + start_x + reset_btn.width;
 
@@ -266,6 +490,24 @@ void Search_Menu::update_ui(Camera& view) {
 		.w = rc_width,
 		.h = tall_label_h
 	};
+
+	if (menu_type == MenuValue) {
+		float rl_width = results_lbl.font->render.text_width(results_lbl.text.c_str()) * 1.1f / view.scale;
+		float pl_width = prefetch_lbl.font->render.text_width(prefetch_lbl.text.c_str()) * 1.1f / view.scale;
+
+		prefetch_lbl.pos = {
+			.x = start_x + rl_width + 2*start_x,
+			.y = y,
+			.w = pl_width,
+			.h = tall_label_h
+		};
+		prefetch_edit.pos = {
+			.x = prefetch_lbl.pos.x + pl_width + border,
+			.y = y,
+			.w = 50,
+			.h = tall_label_h
+		};
+	}
 	y += tall_label_h + border;
 
 	results.pos = {
@@ -283,6 +525,31 @@ void Search_Menu::update_ui(Camera& view) {
 	};
 }
 
+// in the same order as object_method_options
+static const int object_methods[] = {
+	METHOD_EQUALS, METHOD_RANGE, METHOD_NEAR, METHOD_ROUNDS_TO, METHOD_TRUNCATES_TO
+};
+
+static bool method_uses_value1(int method) {
+	return method == METHOD_EQUALS || method == METHOD_RANGE || method == METHOD_CHANGED_BY ||
+		method == METHOD_NEAR || method == METHOD_ROUNDS_TO || method == METHOD_TRUNCATES_TO;
+}
+
+static bool method_uses_value2(int method) {
+	return method == METHOD_RANGE || method == METHOD_NEAR;
+}
+
+// 'Rounds to' and 'truncates to' don't take a second value, they go by how many decimal places the first one was typed with
+static s64 get_second_value(int method, u32 flags, const char *value1_str, const char *value2_str) {
+	if ((flags & FLAG_FLOAT) && (method == METHOD_ROUNDS_TO || method == METHOD_TRUNCATES_TO)) {
+		Value64 step;
+		step.d = get_decimal_step(value1_str);
+		return step.i;
+	}
+
+	return evaluate_number(value2_str, flags & FLAG_FLOAT).i;
+}
+
 void Search_Menu::set_object_row_visibility(int col, int row) {
 	auto method_dd = dynamic_cast<Drop_Down*>((UI_Element*)object.data->columns[3][row]);
 	auto value1_edit = dynamic_cast<Edit_Box*>((UI_Element*)object.data->columns[4][row]);
@@ -290,13 +557,10 @@ void Search_Menu::set_object_row_visibility(int col, int row) {
 
 	method_dd->visible = true;
 
-	if (method_dd->sel == 0) { // Equals
-		value1_edit->visible = true;
-		value2_edit->visible = false;
-	}
-	else if (method_dd->sel == 1) { // Range
-		value1_edit->visible = true;
-		value2_edit->visible = true;
+	if (method_dd->sel >= 0) {
+		int method = object_methods[method_dd->sel];
+		value1_edit->visible = method_uses_value1(method);
+		value2_edit->visible = method_uses_value2(method);
 	}
 }
 
@@ -326,7 +590,10 @@ void search_source_edit_handler(Edit_Box *edit, Input& input) {
 
 void search_method_dd_handler(UI_Element *elem, Camera& view, bool dbl_click) {
 	auto sm = dynamic_cast<Search_Menu*>(elem->parent);
-	sm->value2_edit.visible = sm->method_dd.sel == 1;
+	int method = sm->method_dd.sel;
+	sm->value1_edit.visible = method_uses_value1(method);
+	sm->value2_edit.visible = method_uses_value2(method);
+	sm->value1_edit.needs_redraw = true;
 	sm->value2_edit.needs_redraw = true;
 }
 
@@ -368,7 +635,7 @@ void search_object_table_cell_init(Table *table, int col, int row) {
 	if (col == 3) {
 		auto dd = dynamic_cast<Drop_Down*>(elem);
 		dd->action = search_object_table_method_handler;
-		dd->external = &sm->method_options;
+		dd->external = &sm->object_method_options;
 		dd->keep_selected = true;
 		dd->sel = 0;
 		dd->title_off_y = -0.2;
@@ -395,7 +662,11 @@ bool Search_Menu::prepare_object_params() {
 
 		Field *f = &record->fields.data[i];
 
-		int method = dynamic_cast<Drop_Down*>((UI_Element*)object_table.columns[3][i])->sel;
+		int sel = dynamic_cast<Drop_Down*>((UI_Element*)object_table.columns[3][i])->sel;
+		if (sel < 0)
+			continue;
+
+		int method = object_methods[sel];
 
 		params_pool[n_params] = {
 			.flags = f->flags & FIELD_FLAGS,
@@ -406,14 +677,12 @@ bool Search_Menu::prepare_object_params() {
 			.value2 = 0
 		};
 
-		if (method == METHOD_EQUALS || method == METHOD_RANGE) {
-			const char *value_str = dynamic_cast<Edit_Box*>((UI_Element*)object_table.columns[4][i])->editor.text.c_str();
-			params_pool[n_params].value1 = evaluate_number(value_str, f->flags & FLAG_FLOAT).i;
-		}
-		if (method == METHOD_RANGE) {
-			const char *value_str = dynamic_cast<Edit_Box*>((UI_Element*)object_table.columns[5][i])->editor.text.c_str();
-			params_pool[n_params].value2 = evaluate_number(value_str, f->flags & FLAG_FLOAT).i;
-		}
+		const char *value1_str = dynamic_cast<Edit_Box*>((UI_Element*)object_table.columns[4][i])->editor.text.c_str();
+		const char *value2_str = dynamic_cast<Edit_Box*>((UI_Element*)object_table.columns[5][i])->editor.text.c_str();
+
+		params_pool[n_params].value1 = evaluate_number(value1_str, f->flags & FLAG_FLOAT).i;
+		if (method != METHOD_EQUALS)
+			params_pool[n_params].value2 = get_second_value(method, f->flags, value1_str, value2_str);
 
 		n_params++;
 	}
@@ -426,6 +695,145 @@ bool Search_Menu::prepare_object_params() {
 	search.n_params = n_params;
 
 	search.byte_align = (int)evaluate_number(align_edit.editor.text.c_str()).i;
+	search.resident_only = resident_cb.checked;
+
+	search.start_addr = evaluate_number(start_addr_edit.editor.text.c_str()).i;
+	search.end_addr = evaluate_number(end_addr_edit.editor.text.c_str()).i;
+
+	search.source_type = source->type;
+	search.pid = source->pid;
+	search.identifier = source->identifier;
+
+	return true;
+}
+
+bool Search_Menu::prepare_pattern_param() {
+	if (!parse_byte_pattern(value1_edit.editor.text.c_str(), search.patterns[0]))
+		return false;
+
+	search.n_patterns = 1;
+
+	search.record = nullptr;
+	search.params = nullptr;
+	search.n_params = 0;
+
+	search.byte_align = (int)evaluate_number(align_edit.editor.text.c_str()).i;
+	search.resident_only = resident_cb.checked;
+
+	search.start_addr = evaluate_number(start_addr_edit.editor.text.c_str()).i;
+	search.end_addr = evaluate_number(end_addr_edit.editor.text.c_str()).i;
+
+	search.source_type = source->type;
+	search.pid = source->pid;
+	search.identifier = source->identifier;
+
+	return true;
+}
+
+bool Search_Menu::prepare_text_param() {
+	int encoding = method_dd.sel >= 0 ? method_dd.sel : TEXT_ANY;
+	search.n_patterns = make_text_patterns(value1_edit.editor.text.c_str(), encoding, case_cb.checked, search.patterns);
+	if (!search.n_patterns)
+		return false;
+
+	search.record = nullptr;
+	search.params = nullptr;
+	search.n_params = 0;
+
+	search.byte_align = (int)evaluate_number(align_edit.editor.text.c_str()).i;
+	search.resident_only = resident_cb.checked;
+
+	search.start_addr = evaluate_number(start_addr_edit.editor.text.c_str()).i;
+	search.end_addr = evaluate_number(end_addr_edit.editor.text.c_str()).i;
+
+	search.source_type = source->type;
+	search.pid = source->pid;
+	search.identifier = source->identifier;
+
+	return true;
+}
+
+bool Search_Menu::prepare_pointer_param() {
+	if (value1_edit.editor.text.size() == 0)
+		return false;
+
+	int depth = (int)evaluate_number(depth_edit.editor.text.c_str()).i;
+	if (depth <= 0)
+		return false;
+
+	search.record = nullptr;
+	search.params = nullptr;
+	search.n_params = 0;
+	search.n_patterns = 0;
+
+	search.pointer_target = evaluate_number(value1_edit.editor.text.c_str()).i;
+	search.max_depth = depth < MAX_POINTER_DEPTH ? depth : MAX_POINTER_DEPTH;
+	search.max_offset = (int)evaluate_number(offset_edit.editor.text.c_str()).i;
+
+	search.byte_align = (int)evaluate_number(align_edit.editor.text.c_str()).i;
+	search.resident_only = resident_cb.checked;
+
+	search.start_addr = evaluate_number(start_addr_edit.editor.text.c_str()).i;
+	search.end_addr = evaluate_number(end_addr_edit.editor.text.c_str()).i;
+
+	search.source_type = source->type;
+	search.pid = source->pid;
+	search.identifier = source->identifier;
+
+	return true;
+}
+
+// Each value is written as a type followed by the value itself, eg. "int32_t 100, float 1.5"
+bool Search_Menu::prepare_group_param() {
+	Search_Parameter values[MAX_GROUP_VALUES];
+	int n_values = 0;
+
+	std::string& text = value1_edit.editor.text;
+	int pos = 0;
+	while (pos < text.size()) {
+		int comma = text.find(',', pos);
+		if (comma < 0)
+			comma = text.size();
+
+		std::string item = text.substr(pos, comma - pos);
+		pos = comma + 1;
+
+		int first = item.find_first_not_of(" \t");
+		if (first < 0)
+			continue;
+
+		int space = item.find_first_of(" \t", first);
+		if (space < 0 || n_values >= MAX_GROUP_VALUES)
+			return false;
+
+		std::string type = item.substr(first, space - first);
+		Bucket& buck = parent->definitions[type.c_str()];
+
+		const u32 min_flags = FLAG_OCCUPIED | FLAG_PRIMITIVE;
+		if ((buck.flags & min_flags) != min_flags)
+			return false;
+
+		values[n_values++] = {
+			.flags = buck.flags & FIELD_FLAGS,
+			.method = METHOD_EQUALS,
+			.offset = 0,
+			.size = (int)buck.value,
+			.value1 = evaluate_number(item.c_str() + space, buck.flags & FLAG_FLOAT).i,
+			.value2 = 0
+		};
+	}
+
+	int window = (int)evaluate_number(window_edit.editor.text.c_str()).i;
+	if (!make_value_group(values, n_values, window, order_cb.checked, search.group))
+		return false;
+
+	search.record = nullptr;
+	search.params = nullptr;
+	search.n_params = 0;
+	search.n_patterns = 0;
+
+	search.byte_align = (int)evaluate_number(align_edit.editor.text.c_str()).i;
+	search.resident_only = resident_cb.checked;
 
 	search.start_addr = evaluate_number(start_addr_edit.editor.text.c_str()).i;
 	search.end_addr = evaluate_number(end_addr_edit.editor.text.c_str()).i;
@@ -461,10 +869,13 @@ bool Search_Menu::prepare_value_param() {
 		.offset = 0,
 		.size = (int)buck.value,
 		.value1 = evaluate_number(value1_edit.editor.text.c_str(), buck.flags & FLAG_FLOAT).i,
-		.value2 = evaluate_number(value2_edit.editor.text.c_str(), buck.flags & FLAG_FLOAT).i
+		.value2 = get_second_value(method_dd.sel, buck.flags, value1_edit.editor.text.c_str(), value2_edit.editor.text.c_str())
 	};
 
 	search.byte_align = (int)evaluate_number(align_edit.editor.text.c_str()).i;
+	search.resident_only = resident_cb.checked;
+	search.track_writes = writes_cb.checked;
+	search.live_chunks_only = heap_cb.checked;
 
 	search.start_addr = evaluate_number(start_addr_edit.editor.text.c_str()).i;
 	search.end_addr = evaluate_number(end_addr_edit.editor.text.c_str()).i;
@@ -479,34 +890,166 @@ bool Search_Menu::prepare_value_param() {
 void search_search_btn_handler(UI_Element *elem, Camera& view, bool dbl_click) {
 	auto sm = dynamic_cast<Search_Menu*>(elem->parent);
 
-	if (!sm->source || check_search_running())
+	if (!sm->source || check_search_running(*sm->session))
 		return;
 
 	bool ok = false;
 	if (sm->menu_type == MenuObject)
 		ok = sm->prepare_object_params();
+	else if (sm->menu_type == MenuPattern)
+		ok = sm->prepare_pattern_param();
+	else if (sm->menu_type == MenuText)
+		ok = sm->prepare_text_param();
+	else if (sm->menu_type == MenuPointer)
+		ok = sm->prepare_pointer_param();
+	else if (sm->menu_type == MenuGroup)
+		ok = sm->prepare_group_param();
 	else
 		ok = sm->prepare_value_param();
 
+	if (ok && sm->menu_type == MenuValue) {
+		std::string& path = sm->file_edit.editor.text;
+		if (path.size() > 0 && path != sm->attached_path) {
+			Source *src = sm->source;
+			const char *name = src->type == SourceFile ? (const char*)src->identifier : src->name.c_str();
+			if (attach_search_file(*sm->session, path.c_str(), src->type, src->pid, name, sm->type_edit.editor.text.c_str()))
+				sm->attached_path = path;
+		}
+	}
+
 	if (ok) {
 		sm->cancel_btn.set_active(true);
-		start_search(sm->search, sm->source->regions);
+		sm->reset_btn.set_active(false);
+		sm->results_table.resize(0);
+		sm->progress_bar.fraction = 0;
+		start_search(*sm->session, sm->search, sm->source->regions);
 	}
 }
 
 void search_cancel_btn_handler(UI_Element *elem, Camera& view, bool dbl_click) {
-	
+	auto sm = dynamic_cast<Search_Menu*>(elem->parent);
+	cancel_search(*sm->session);
 }
 
 void search_reset_btn_handler(UI_Element *elem, Camera& view, bool dbl_click) {
 	auto sm = dynamic_cast<Search_Menu*>(elem->parent);
+	if (check_search_running(*sm->session))
+		return;
 
-	reset_search();
+	reset_search(*sm->session);
+	sm->attached_path.clear();
 	sm->results_table.resize(0);
 	sm->results_count_lbl.text = "";
 	sm->require_redraw();
 }
 
+static void set_edit_text(Edit_Box& edit, const char *text) {
+	edit.editor.clear();
+	edit.editor.text = text;
+	edit.needs_redraw = true;
+}
+
+static void set_value_edit(Edit_Box& edit, s64 value, u32 flags) {
+	char buf[40];
+	Value64 v = { .i = value };
+	if (flags & FLAG_FLOAT)
+		snprintf(buf, 40, "%.17g", v.d);
+	else if (flags & FLAG_SIGNED)
+		snprintf(buf, 40, "%lld", (long long)value);
+	else
+		snprintf(buf, 40, "%llu", (unsigned long long)value);
+
+	set_edit_text(edit, buf);
+}
+
+void search_resume_btn_handler(UI_Element *elem, Camera& view, bool dbl_click) {
+	auto sm = dynamic_cast<Search_Menu*>(elem->parent);
+	Workspace& ws = *sm->parent;
+
+	std::string path = sm->file_edit.editor.text;
+	if (path.size() == 0 || check_search_running(*sm->session))
+		return;
+
+	Search_File_Info info;
+	if (!resume_search_file(*sm->session, path.c_str(), info)) {
+		sdl_log_string("Error: could not resume the search from this file");
+		return;
+	}
+	sm->attached_path = path;
+
+	// look for the source the file was made from, so that refining carries on where it left off
+	Source *src = nullptr;
+	for (auto& s : ws.sources) {
+		if (s->type != info.source_type)
+			continue;
+		if (s->type == SourceFile && s->identifier && !strcmp((char*)s->identifier, info.source_name)) {
+			src = s;
+			break;
+		}
+		if (s->type == SourceProcess && s->pid == info.pid) {
+			src = s;
+			break;
+		}
+	}
+	if (!src) {
+		for (auto& s : ws.sources) {
+			if (s->type == info.source_type && s->name == info.source_name) {
+				src = s;
+				break;
+			}
+		}
+	}
+	if (src) {
+		sm->source = src;
+		set_edit_text(sm->source_edit, src->name.c_str());
+	}
+
+	Search_Parameter& last = info.history.back();
+	sm->search.single_value = last;
+	set_edit_text(sm->type_edit, info.type_name);
+	sm->method_dd.sel = last.method;
+
+	if (method_uses_value1(last.method))
+		set_value_edit(sm->value1_edit, last.value1, last.flags);
+	if (last.method == METHOD_RANGE || last.method == METHOD_NEAR)
+		set_value_edit(sm->value2_edit, last.value2, last.flags);
+
+	sm->value1_edit.visible = sm->params_revealed && method_uses_value1(last.method);
+	sm->value2_edit.visible = sm->params_revealed && method_uses_value2(last.method);
+
+	char buf[24];
+	snprintf(buf, 24, "0x%016llx", (unsigned long long)info.start_addr);
+	set_edit_text(sm->start_addr_edit, buf);
+	snprintf(buf, 24, "0x%016llx", (unsigned long long)info.end_addr);
+	set_edit_text(sm->end_addr_edit, buf);
+
+	if (info.byte_align > 0)
+		set_value_edit(sm->align_edit, info.byte_align, 0);
+	else
+		sm->align_edit.editor.clear();
+
+	sm->fill_results();
+
+	sm->require_redraw();
+}
+
+void search_combine_btn_handler(UI_Element *elem, Camera& view, bool dbl_click) {
+	auto sm = dynamic_cast<Search_Menu*>(elem->parent);
+
+	int op = sm->combine_dd.sel;
+	int target = sm->target_dd.sel;
+	if (op < 0 || target < 0 || target >= sm->targets.size())
+		return;
+
+	u64 distance = evaluate_number(sm->distance_edit.editor.text.c_str()).i;
+	if (!combine_search_results(*sm->session, *sm->targets[target]->session, op, distance))
+		return;
+
+	sm->fill_results();
+
+	sm->require_redraw();
+}
+
 void search_reveal_btn_handler(UI_Element *elem, Camera& view, bool dbl_click) {
 	auto sm = dynamic_cast<Search_Menu*>(elem->parent);
 
@@ -521,6 +1064,7 @@ void search_reveal_btn_handler(UI_Element *elem, Camera& view, bool dbl_click) {
 	sm->end_addr_edit.visible = sm->params_revealed;
 	sm->align_lbl.visible = sm->params_revealed;
 	sm->align_edit.visible = sm->params_revealed;
+	sm->resident_cb.visible = sm->params_revealed;
 	sm->object_lbl.visible = sm->params_revealed;
 	sm->object.visible = sm->params_revealed;
 	sm->object_scroll.visible = sm->params_revealed;
@@ -530,8 +1074,33 @@ void search_reveal_btn_handler(UI_Element *elem, Camera& view, bool dbl_click) {
 	sm->method_lbl.visible = sm->params_revealed;
 	sm->method_dd.visible = sm->params_revealed;
 	sm->value_lbl.visible = sm->params_revealed;
-	sm->value1_edit.visible = sm->params_revealed;
-	sm->value2_edit.visible = sm->params_revealed;
+	sm->depth_lbl.visible = sm->params_revealed;
+	sm->depth_edit.visible = sm->params_revealed;
+	sm->offset_lbl.visible = sm->params_revealed;
+	sm->offset_edit.visible = sm->params_revealed;
+	sm->window_lbl.visible = sm->params_revealed;
+	sm->window_edit.visible = sm->params_revealed;
+	sm->order_cb.visible = sm->params_revealed;
+
+	sm->case_cb.visible = sm->params_revealed;
+	sm->writes_cb.visible = sm->params_revealed;
+	sm->heap_cb.visible = sm->params_revealed;
+	sm->file_edit.visible = sm->params_revealed;
+	sm->resume_btn.visible = sm->params_revealed;
+	sm->combine_dd.visible = sm->params_revealed;
+	sm->distance_edit.visible = sm->params_revealed;
+	sm->target_dd.visible = sm->params_revealed;
+	sm->combine_btn.visible = sm->params_revealed;
+
+	int method = sm->method_dd.sel;
+	if (sm->menu_type == MenuPattern || sm->menu_type == MenuText || sm->menu_type == MenuPointer || sm->menu_type == MenuGroup) {
+		sm->value1_edit.visible = sm->params_revealed;
+		sm->value2_edit.visible = false;
+	}
+	else {
+		sm->value1_edit.visible = sm->params_revealed && method_uses_value1(method);
+		sm->value2_edit.visible = sm->params_revealed && method_uses_value2(method);
+	}
 
 	sm->update_reveal_button(view.scale);
 
@@ -570,6 +1139,35 @@ void Search_Menu::refresh(Point *cursor) {
 	for (int i = 0; i < n_sources; i++)
 		source_dd.content[i] = (char*)ws.sources[i]->name.c_str();
 
+	// the list only gets rebuilt when the other search boxes change, so that it doesn't move around under an open menu
+	std::vector<Search_Menu*> others;
+	for (auto& b : ws.boxes) {
+		if (b != this && b->box_type == BoxSearch && b->visible)
+			others.push_back(dynamic_cast<Search_Menu*>(b));
+	}
+	std::sort(others.begin(), others.end(), [](Search_Menu *a, Search_Menu *b) {
+		return a->search_id < b->search_id;
+	});
+
+	if (others != targets) {
+		Search_Menu *selected = target_dd.sel >= 0 && target_dd.sel < targets.size() ? targets[target_dd.sel] : nullptr;
+		targets = others;
+
+		int n_targets = targets.size();
+		target_names.resize(n_targets);
+		target_dd.content.resize(n_targets);
+		target_dd.sel = n_targets > 0 ? 0 : -1;
+
+		for (int i = 0; i < n_targets; i++) {
+			target_names[i] = targets[i]->title.text;
+			target_dd.content[i] = (char*)target_names[i].c_str();
+			if (targets[i] == selected)
+				target_dd.sel = i;
+		}
+
+		target_dd.needs_redraw = true;
+	}
+
 	type_dd.content.resize(0);
 	const u32 flags = FLAG_OCCUPIED | FLAG_PRIMITIVE;
 
@@ -580,21 +1178,182 @@ void Search_Menu::refresh(Point *cursor) {
 		}
 	}
 
-	//results_count_lbl.text = std::to_string(search.results.size());
+	if (check_search_running(*session)) {
+		Search_Progress progress;
+		get_search_progress(*session, progress);
 
-	if (check_search_finished()) {
-		cancel_btn.set_active(false);
+		progress_bar.fraction = progress.total > 0 ? (float)((double)progress.done / (double)progress.total) : 0;
+		results_count_lbl.text = std::to_string(progress.matches);
 
-		get_search_results((std::vector<u64>&)results_table.columns[0]);
+		// fill the table with whatever results have come in since the last refresh, while the search carries on
+		u64 partial[1024];
+		auto& addrs = (std::vector<u64>&)results_table.columns[0];
+		int n = 0;
+		while ((n = take_partial_results(*session, partial, 1024)) > 0)
+			addrs.insert(addrs.end(), partial, partial + n);
 
-		int n_results = results_table.columns[0].size();
-		results_table.columns[1].resize(n_results, nullptr);
+		results_table.resize(addrs.size());
 
-		results_count_lbl.text = std::to_string(n_results);
+		results_count_lbl.needs_redraw = true;
+		results.needs_redraw = true;
+	}
+
+	if (check_search_finished(*session)) {
+		cancel_btn.set_active(false);
+		reset_btn.set_active(true);
+		progress_bar.fraction = 0;
+
+		fill_results();
 
 		results_count_lbl.needs_redraw = true;
 		results.needs_redraw = true;
 	}
+
+	if (menu_type == MenuValue)
+		update_live_values();
+}
+
+void Search_Menu::fill_results() {
+	auto& addrs = (std::vector<u64>&)results_table.columns[0];
+	get_search_results(*session, addrs);
+
+	// value searches show live values instead of labels, which point into live_values until update_live_values() points them somewhere else
+	if (menu_type == MenuValue) {
+		results_table.columns[1].assign(addrs.size(), nullptr);
+		results_table.columns[2].assign(addrs.size(), nullptr);
+	}
+	else
+		get_search_result_labels(*session, (std::vector<char*>&)results_table.columns[1]);
+
+	results_table.resize(addrs.size());
+	results_count_lbl.text = std::to_string(get_search_result_count(*session));
+}
+
+static void format_live_value(const u8 *data, Search_Parameter& param, char *out) {
+	int size = param.size / 8;
+	u64 n = 0;
+	memcpy(&n, data, size);
+
+	if (param.flags & FLAG_FLOAT) {
+		float f;
+		double d;
+		memcpy(&f, &n, sizeof(float));
+		memcpy(&d, &n, sizeof(double));
+
+		char *end = size == 4 ?
+			std::to_chars(out, out + LIVE_VALUE_LEN - 1, f).ptr :
+			std::to_chars(out, out + LIVE_VALUE_LEN - 1, d).ptr;
+		*end = 0;
+	}
+	else if (param.flags & FLAG_SIGNED) {
+		if (size < 8 && (n >> (size * 8 - 1)) & 1)
+			n |= ~0ULL << (size * 8);
+		snprintf(out, LIVE_VALUE_LEN, "%lld", (long long)n);
+	}
+	else
+		snprintf(out, LIVE_VALUE_LEN, "%llu", (unsigned long long)n);
+}
+
+void Search_Menu::release_live_values() {
+	int n_rows = results_table.columns[1].size();
+	for (int i = 0; i < live_values.size() && live_start + i < n_rows; i++) {
+		results_table.columns[1][live_start + i] = nullptr;
+		results_table.columns[2][live_start + i] = nullptr;
+	}
+
+	if (live_source) {
+		for (int idx : value_spans)
+			live_source->deactivate_span(idx);
+	}
+
+	live_source = nullptr;
+	value_spans.resize(0);
+	live_values.resize(0);
+	live_start = 0;
+}
+
+// Each result near the visible rows gets a span on the source, so that their values are read along with everything else on the source in one batch.
+// Spans are read after every box has been refreshed, so what's in them now is what was asked for by the last call to this.
+void Search_Menu::update_live_values() {
+	auto& addrs = (std::vector<u64>&)results_table.columns[0];
+	int n_rows = std::min(addrs.size(), results_table.columns[1].size());
+	int size = search.single_value.size / 8;
+
+	if (!source || source != live_source || size <= 0 || size > 8 || n_rows == 0) {
+		release_live_values();
+		if (!source || size <= 0 || size > 8 || n_rows == 0)
+			return;
+	}
+	live_source = source;
+
+	for (int i = 0; i < live_values.size(); i++) {
+		Live_Value& lv = live_values[i];
+		Span& span = source->spans[value_spans[i]];
+		if (span.address != lv.address || span.retrieved < size || !span.data)
+			continue;
+
+		if (lv.seen && memcmp(lv.current, span.data, size) == 0)
+			continue;
+
+		if (lv.seen)
+			memcpy(lv.previous, lv.value, LIVE_VALUE_LEN);
+
+		memcpy(lv.current, span.data, size);
+		format_live_value(lv.current, search.single_value, lv.value);
+		lv.seen = true;
+		results.needs_redraw = true;
+	}
+
+	int prefetch = (int)evaluate_number(prefetch_edit.editor.text.c_str()).i;
+	prefetch = prefetch < 0 ? 0 : prefetch > MAX_PREFETCH_ROWS ? MAX_PREFETCH_ROWS : prefetch;
+
+	int top = (int)results_scroll.position;
+	int n_visible = results.item_height > 0 ? (results.pos.h - results.header_height) / results.item_height + 1 : 0;
+
+	int first = top - prefetch;
+	int last = top + n_visible + prefetch;
+	first = first < 0 ? 0 : first > n_rows ? n_rows : first;
+	last = last < first ? first : last > n_rows ? n_rows : last;
+
+	// rows that are still in the window keep what's been seen of them so far
+	std::vector<Live_Value> next(last - first);
+	for (int i = 0; i < next.size(); i++) {
+		int old = first + i - live_start;
+		if (old >= 0 && old < live_values.size() && live_values[old].address == addrs[first + i])
+			next[i] = live_values[old];
+		else
+			next[i] = { .address = addrs[first + i] };
+	}
+
+	int n_cells = results_table.columns[1].size();
+	for (int i = 0; i < live_values.size() && live_start + i < n_cells; i++) {
+		results_table.columns[1][live_start + i] = nullptr;
+		results_table.columns[2][live_start + i] = nullptr;
+	}
+
+	live_values.swap(next);
+	live_start = first;
+
+	while (value_spans.size() < live_values.size())
+		value_spans.push_back(source->request_span());
+	while (value_spans.size() > live_values.size()) {
+		source->deactivate_span(value_spans.back());
+		value_spans.pop_back();
+	}
+
+	for (int i = 0; i < live_values.size(); i++) {
+		Live_Value& lv = live_values[i];
+		Span& span = source->spans[value_spans[i]];
+		if (span.address != lv.address || span.size != size) {
+			span.address = lv.address;
+			span.size = size;
+			span.retrieved = 0;
+			span.data = nullptr;
+		}
+
+		results_table.columns[1][first + i] = lv.value;
+		results_table.columns[2][first + i] = lv.previous;
+	}
 }
 
 void Search_Menu::handle_zoom(Workspace& ws, float new_scale) {
@@ -608,13 +1367,21 @@ void Search_Menu::handle_zoom(Workspace& ws, float new_scale) {
 		struct_edit.update_icon(IconTriangle, edit_h, new_scale);
 		object_div.make_icon(new_scale);
 	}
-	else
+	else if (menu_type == MenuValue)
 		type_edit.update_icon(IconTriangle, edit_h, new_scale);
 
 	sdl_destroy_texture(&method_dd.icon);
 	method_dd.icon_length = dd_font->render.text_height() * EDIT_HEIGHT_FACTOR;
 	method_dd.icon = make_triangle(method_dd.icon_color, method_dd.icon_length, method_dd.icon_length);
 
+	sdl_destroy_texture(&combine_dd.icon);
+	combine_dd.icon_length = method_dd.icon_length;
+	combine_dd.icon = make_triangle(combine_dd.icon_color, combine_dd.icon_length, combine_dd.icon_length);
+
+	sdl_destroy_texture(&target_dd.icon);
+	target_dd.icon_length = method_dd.icon_length;
+	target_dd.icon = make_triangle(target_dd.icon_color, target_dd.icon_length, target_dd.icon_length);
+
 	sdl_destroy_texture(&search_btn.icon);
 	float search_h = search_btn.get_icon_length(new_scale);
 	search_btn.icon = make_glass_icon(search_btn.default_color, search_h);
@@ -624,8 +1391,15 @@ void Search_Menu::handle_zoom(Workspace& ws, float new_scale) {
 }
 
 void Search_Menu::on_close() {
+	release_live_values();
+
+	// the search might still be reading from params_pool, so it has to be stopped first
+	close_search_session(session);
+	session = nullptr;
+
 	if (params_pool)
 		delete[] params_pool;
+	params_pool = nullptr;
 }
 
 Search_Menu::Search_Menu(Workspace& ws, MenuType mtype) {
@@ -639,8 +1413,19 @@ Search_Menu::Search_Menu(Workspace& ws, MenuType mtype) {
 	maxm.img = ws.maxm;
 	ui.push_back(&maxm);
 
+	// numbered so that the other search boxes can tell which one is which when combining results
+	static int n_search_menus = 0;
+	search_id = ++n_search_menus;
+
 	title.font = ws.default_font;
-	title.text = mtype == MenuValue ? "Value Search" : "Object Search";
+	title.text =
+		mtype == MenuValue ? "Value Search" :
+		mtype == MenuObject ? "Object Search" :
+		mtype == MenuPattern ? "Pattern Search" :
+		mtype == MenuPointer ? "Pointer Search" :
+		mtype == MenuGroup ? "Group Search" :
+		"Text Search";
+	title.text += " " + std::to_string(search_id);
 	ui.push_back(&title);
 
 	label_font = ws.make_font(11, ws.colors.text, scale);
@@ -720,6 +1505,13 @@ Search_Menu::Search_Menu(Workspace& ws, MenuType mtype) {
 	align_edit.default_color = ws.colors.dark;
 	ui.push_back(&align_edit);
 
+	resident_cb.font = label_font;
+	resident_cb.text = "Resident only";
+	resident_cb.default_color = ws.colors.scroll_back;
+	resident_cb.hl_color = ws.colors.light;
+	resident_cb.sel_color = ws.colors.cb;
+	ui.push_back(&resident_cb);
+
 	if (is_obj) {
 		object_lbl.font = label_font;
 		object_lbl.text = "Object";
@@ -762,6 +1554,111 @@ Search_Menu::Search_Menu(Workspace& ws, MenuType mtype) {
 		object_div.cursor_type = CursorResizeNorthSouth;
 		ui.push_back(&object_div);
 	}
+	else if (mtype == MenuPattern) {
+		value_lbl.font = label_font;
+		value_lbl.text = "Pattern";
+		ui.push_back(&value_lbl);
+
+		value1_edit.font = label_font;
+		value1_edit.ph_font = ws.make_font(label_font->size, icon_color, scale);
+		value1_edit.placeholder = "48 8B ?? ?? 00 00 E8";
+		value1_edit.caret = ws.colors.caret;
+		value1_edit.default_color = ws.colors.dark;
+		ui.push_back(&value1_edit);
+	}
+	else if (mtype == MenuPointer) {
+		value_lbl.font = label_font;
+		value_lbl.text = "Target";
+		ui.push_back(&value_lbl);
+
+		value1_edit.font = label_font;
+		value1_edit.ph_font = ws.make_font(label_font->size, icon_color, scale);
+		value1_edit.placeholder = "Address to find paths to";
+		value1_edit.caret = ws.colors.caret;
+		value1_edit.default_color = ws.colors.dark;
+		ui.push_back(&value1_edit);
+
+		depth_lbl.font = label_font;
+		depth_lbl.text = "Max Depth";
+		ui.push_back(&depth_lbl);
+
+		depth_edit.font = label_font;
+		depth_edit.editor.text = DEFAULT_POINTER_DEPTH;
+		depth_edit.caret = ws.colors.caret;
+		depth_edit.default_color = ws.colors.dark;
+		ui.push_back(&depth_edit);
+
+		offset_lbl.font = label_font;
+		offset_lbl.text = "Max Offset";
+		ui.push_back(&offset_lbl);
+
+		offset_edit.font = label_font;
+		offset_edit.editor.text = DEFAULT_POINTER_OFFSET;
+		offset_edit.caret = ws.colors.caret;
+		offset_edit.default_color = ws.colors.dark;
+		ui.push_back(&offset_edit);
+	}
+	else if (mtype == MenuGroup) {
+		value_lbl.font = label_font;
+		value_lbl.text = "Values";
+		ui.push_back(&value_lbl);
+
+		value1_edit.font = label_font;
+		value1_edit.ph_font = ws.make_font(label_font->size, icon_color, scale);
+		value1_edit.placeholder = "int32_t 100, float 1.5, int16_t 7";
+		value1_edit.caret = ws.colors.caret;
+		value1_edit.default_color = ws.colors.dark;
+		ui.push_back(&value1_edit);
+
+		window_lbl.font = label_font;
+		window_lbl.text = "Within bytes";
+		ui.push_back(&window_lbl);
+
+		window_edit.font = label_font;
+		window_edit.editor.text = DEFAULT_GROUP_WINDOW;
+		window_edit.caret = ws.colors.caret;
+		window_edit.default_color = ws.colors.dark;
+		ui.push_back(&window_edit);
+
+		order_cb.font = label_font;
+		order_cb.text = "In this order";
+		order_cb.default_color = ws.colors.scroll_back;
+		order_cb.hl_color = ws.colors.light;
+		order_cb.sel_color = ws.colors.cb;
+		ui.push_back(&order_cb);
+	}
+	else if (mtype == MenuText) {
+		value_lbl.font = label_font;
+		value_lbl.text = "Text";
+		ui.push_back(&value_lbl);
+
+		value1_edit.font = label_font;
+		value1_edit.caret = ws.colors.caret;
+		value1_edit.default_color = ws.colors.dark;
+		ui.push_back(&value1_edit);
+
+		method_lbl.font = label_font;
+		method_lbl.text = "Encoding";
+		ui.push_back(&method_lbl);
+
+		method_dd.font = dd_font;
+		method_dd.default_color = ws.colors.dark;
+		method_dd.hl_color = ws.colors.hl;
+		method_dd.sel_color = ws.colors.active;
+		method_dd.icon_color = icon_color;
+		method_dd.external = &text_encoding_options;
+		method_dd.leaning = 0.0;
+		method_dd.keep_selected = true;
+		method_dd.sel = TEXT_ANY;
+		ui.push_back(&method_dd);
+
+		case_cb.font = label_font;
+		case_cb.text = "Ignore case";
+		case_cb.default_color = ws.colors.scroll_back;
+		case_cb.hl_color = ws.colors.light;
+		case_cb.sel_color = ws.colors.cb;
+		ui.push_back(&case_cb);
+	}
 	else {
 		type_lbl.font = label_font;
 		type_lbl.text = "Type";
@@ -813,9 +1710,32 @@ Search_Menu::Search_Menu(Workspace& ws, MenuType mtype) {
 		value2_edit.caret = ws.colors.caret;
 		value2_edit.default_color = ws.colors.dark;
 		ui.push_back(&value2_edit);
+
+		writes_cb.font = label_font;
+		writes_cb.text = "Only re-read pages that were written to";
+		writes_cb.default_color = ws.colors.scroll_back;
+		writes_cb.hl_color = ws.colors.light;
+		writes_cb.sel_color = ws.colors.cb;
+		ui.push_back(&writes_cb);
+
+		heap_cb.font = label_font;
+		heap_cb.text = "Only look inside live heap allocations";
+		heap_cb.default_color = ws.colors.scroll_back;
+		heap_cb.hl_color = ws.colors.light;
+		heap_cb.sel_color = ws.colors.cb;
+		ui.push_back(&heap_cb);
+
+		file_edit.font = label_font;
+		file_edit.ph_font = ws.make_font(label_font->size, icon_color, scale);
+		file_edit.placeholder = "Results file (optional)";
+		file_edit.caret = ws.colors.caret;
+		file_edit.default_color = ws.colors.dark;
+		ui.push_back(&file_edit);
 	}
 
-	//Progress_Bar progress_bar;
+	progress_bar.default_color = ws.colors.dark;
+	progress_bar.sel_color = ws.colors.hl;
+	ui.push_back(&progress_bar);
 
 	search_btn.text = "Search";
 	search_btn.action = search_search_btn_handler;
@@ -853,6 +1773,49 @@ Search_Menu::Search_Menu(Workspace& ws, MenuType mtype) {
 	reset_btn.update_size(scale);
 	ui.push_back(&reset_btn);
 
+	if (mtype == MenuValue) {
+		resume_btn.text = "Resume";
+		resume_btn.action = search_resume_btn_handler;
+		resume_btn.active_theme = search_btn.active_theme;
+		resume_btn.inactive_theme = search_btn.inactive_theme;
+		resume_btn.update_size(scale);
+		ui.push_back(&resume_btn);
+	}
+
+	combine_dd.font = dd_font;
+	combine_dd.default_color = ws.colors.dark;
+	combine_dd.hl_color = ws.colors.hl;
+	combine_dd.sel_color = ws.colors.active;
+	combine_dd.icon_color = icon_color;
+	combine_dd.external = &combine_options;
+	combine_dd.leaning = 0.0;
+	combine_dd.keep_selected = true;
+	combine_dd.sel = COMBINE_INTERSECT;
+	ui.push_back(&combine_dd);
+
+	distance_edit.font = label_font;
+	distance_edit.ph_font = ws.make_font(label_font->size, icon_color, scale);
+	distance_edit.placeholder = "bytes";
+	distance_edit.caret = ws.colors.caret;
+	distance_edit.default_color = ws.colors.dark;
+	ui.push_back(&distance_edit);
+
+	target_dd.font = dd_font;
+	target_dd.default_color = ws.colors.dark;
+	target_dd.hl_color = ws.colors.hl;
+	target_dd.sel_color = ws.colors.active;
+	target_dd.icon_color = icon_color;
+	target_dd.leaning = 0.0;
+	target_dd.keep_selected = true;
+	ui.push_back(&target_dd);
+
+	combine_btn.text = "Combine";
+	combine_btn.action = search_combine_btn_handler;
+	combine_btn.active_theme = search_btn.active_theme;
+	combine_btn.inactive_theme = search_btn.inactive_theme;
+	combine_btn.update_size(scale);
+	ui.push_back(&combine_btn);
+
 	reveal_btn.padding = 0;
 	reveal_btn.action = search_reveal_btn_handler;
 	reveal_btn.active_theme = {
@@ -874,11 +1837,38 @@ Search_Menu::Search_Menu(Workspace& ws, MenuType mtype) {
 	results_count_lbl.text = "";
 	ui.push_back(&results_count_lbl);
 
-	Column cols[] = {
-		{ColumnHex, 16, 0.5, 0, 0, "Address"},
-		{ColumnString, 0, 0.5, 0, 0, "Value"},
-	};
-	results_table.init(cols, nullptr, nullptr, nullptr, 2, 0);
+	if (mtype == MenuValue) {
+		Column cols[] = {
+			{ColumnHex, 16, 0.4, 0, 0, "Address"},
+			{ColumnString, 0, 0.3, 0, 0, "Value"},
+			{ColumnString, 0, 0.3, 0, 0, "Previous"},
+		};
+		results_table.init(cols, nullptr, nullptr, nullptr, 3, 0);
+
+		prefetch_lbl.font = label_font;
+		prefetch_lbl.text = "Read ahead";
+		ui.push_back(&prefetch_lbl);
+
+		prefetch_edit.font = label_font;
+		prefetch_edit.editor.text = std::to_string(DEFAULT_PREFETCH_ROWS);
+		prefetch_edit.caret = ws.colors.caret;
+		prefetch_edit.default_color = ws.colors.dark;
+		ui.push_back(&prefetch_edit);
+	}
+	else if (mtype == MenuPointer) {
+		Column cols[] = {
+			{ColumnHex, 16, 0.35, 0, 0, "Address"},
+			{ColumnString, 0, 0.65, 0, 0, "Path"},
+		};
+		results_table.init(cols, nullptr, nullptr, nullptr, 2, 0);
+	}
+	else {
+		Column cols[] = {
+			{ColumnHex, 16, 0.5, 0, 0, "Address"},
+			{ColumnString, 0, 0.5, 0, 0, "Value"},
+		};
+		results_table.init(cols, nullptr, nullptr, nullptr, 2, 0);
+	}
 
 	results.font = table_font;
 	results.data = &results_table;
@@ -903,4 +1893,9 @@ Search_Menu::Search_Menu(Workspace& ws, MenuType mtype) {
 	min_width = 300;
 	min_height = min_revealed_height;
 	refresh_every = 1;
+
+	session = open_search_session();
+
+	// each search box runs its own search, so there can be as many of them as needed
+	expungeable = true;
 }
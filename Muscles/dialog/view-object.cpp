@@ -84,6 +84,14 @@ void View_Object::update_ui(Camera& camera) {
 			edit_h
 		};
 
+		float heap_x = addr_edit.pos.x + addr_edit.pos.w + 2*border;
+		heap_label.pos = {
+			heap_x,
+			addr_label.pos.y,
+			box.w - heap_x - 2*border,
+			label_h
+		};
+
 		y += edit_gap + border;
 	}
 	else
@@ -182,6 +190,10 @@ void source_edit_handler(Edit_Box *edit, Input& input) {
 		if (ui->source && ui->span_idx >= 0)
 			ui->source->deactivate_span(ui->span_idx);
 
+		if (ui->path_handle)
+			close_readonly_handle(ui->path_handle);
+		ui->path_handle = (SOURCE_HANDLE)0;
+
 		ui->source = src;
 		ui->span_idx = src ? src->request_span() : -1;
 	}
@@ -208,9 +220,28 @@ void View_Object::refresh(Point *cursor) {
 
 	Span& span = source->spans[span_idx];
 
-	span.address = strtoull(addr_edit.editor.text.c_str(), nullptr, 16);
+	// the address can also be a path from a pointer search (eg. "[[game+0x1a2b0]+0x18]+0x40"), which is followed again every time
+	const char *addr_text = addr_edit.editor.text.c_str();
+	if (addr_text[0] == '[') {
+		if (!path_handle) {
+			if (source->type == SourceFile)
+				path_handle = get_readonly_file_handle(source->identifier);
+			else if (source->type == SourceProcess)
+				path_handle = get_readonly_process_handle(source->pid);
+		}
+
+		u64 address = 0;
+		if (path_handle)
+			resolve_pointer_path(path_handle, source->type, source->pid, source->regions, addr_text, address);
+
+		span.address = address;
+	}
+	else
+		span.address = strtoull(addr_text, nullptr, 16);
 	span.size = (record->total_size + 7) / 8;
 
+	update_heap_label(span.address);
+
 	field_vec.clear();
 
 	int idx = -1;
@@ -240,6 +271,28 @@ void View_Object::refresh(Point *cursor) {
 	}
 }
 
+// Shows which allocation the object is in, if the source is a process that uses glibc's malloc
+void View_Object::update_heap_label(u64 address) {
+	heap_label.text.clear();
+	if (source->type != SourceProcess || meta_hidden)
+		return;
+
+	const Heap_Chunk *chunk = find_source_heap_chunk(*source, address);
+	if (!chunk)
+		return;
+
+	u64 alloc = chunk->address + HEAP_CHUNK_HEADER;
+	const char *state = (chunk->flags & HEAP_CHUNK_IN_USE) ? "in use" : "free";
+
+	char buf[80];
+	if (address < alloc)
+		snprintf(buf, 80, "header of 0x%llx (%s)", (unsigned long long)alloc, state);
+	else
+		snprintf(buf, 80, "0x%llx + 0x%llx (%s)", (unsigned long long)alloc, (unsigned long long)(address - alloc), state);
+
+	heap_label.text = buf;
+}
+
 void View_Object::handle_zoom(Workspace& ws, float new_scale) {
 	cross.img = ws.cross;
 	maxm.img = ws.maxm;
@@ -251,8 +304,32 @@ void View_Object::handle_zoom(Workspace& ws, float new_scale) {
 	source_edit.update_icon(IconTriangle, height, new_scale);
 }
 
+void view_object_ref_handler(Workspace& ws, Box *box) {
+	auto ui = dynamic_cast<View_Object*>(box);
+	int idx = ws.rclick_menu.hl - 1;
+	if (idx >= 0 && idx < ui->refs.size())
+		ws.view_source_at(ui->source, ui->refs[idx]);
+}
+
+// Right-clicking shows what points anywhere inside the object
+void View_Object::prepare_rclick_menu(Context_Menu& menu, Camera& view, Point& cursor) {
+	rclick_menu_items.resize(0);
+	if (!source || span_idx < 0)
+		return;
+
+	Span& span = source->spans[span_idx];
+	if (span.size <= 0)
+		return;
+
+	make_pointer_refs_menu(source, span.address, span.address + span.size, refs, ref_labels, rclick_menu_items, view_object_ref_handler);
+}
+
 void View_Object::on_close() {
 	source->deactivate_span(span_idx);
+
+	if (path_handle)
+		close_readonly_handle(path_handle);
+	path_handle = (SOURCE_HANDLE)0;
 }
 
 View_Object::View_Object(Workspace& ws, MenuType mtype) {
@@ -281,6 +358,7 @@ View_Object::View_Object(Workspace& ws, MenuType mtype) {
 		ui->struct_label.visible = ui->struct_edit.visible = !ui->meta_hidden;
 		ui->source_label.visible = ui->source_edit.visible = !ui->meta_hidden;
 		ui->addr_label.visible = ui->addr_edit.visible = !ui->meta_hidden;
+		ui->heap_label.visible = !ui->meta_hidden;
 		ui->update_hide_meta_button(view.scale);
 	};
 	hide_meta.active_theme = {
@@ -355,6 +433,10 @@ View_Object::View_Object(Workspace& ws, MenuType mtype) {
 	addr_edit.default_color = ws.colors.dark;
 	ui.push_back(&addr_edit);
 
+	heap_label.font = addr_label.font;
+	heap_label.padding = 0;
+	ui.push_back(&heap_label);
+
 	source_dd.edit_elem = &source_edit;
 	source_dd.font = source_label.font;
 	source_dd.default_color = ws.colors.back;
@@ -339,6 +339,61 @@ void View_Source::refresh(Point *cursor) {
 	}
 }
 
+void make_pointer_refs_menu(Source *source, u64 start, u64 end, std::vector<u64>& refs, std::vector<std::string>& labels, std::vector<Menu_Item>& items, void (*action)(Workspace&, Box*)) {
+	items.resize(0);
+	if (!source || source->type != SourceProcess)
+		return;
+
+	u64 total = 0;
+	if (!find_pointers_to(*source, start, end, refs, MAX_POINTER_REF_ITEMS, total)) {
+		labels.resize(1);
+		labels[0] = "Indexing pointers...";
+		items.push_back({FLAG_INACTIVE, (char*)labels[0].c_str(), nullptr});
+		return;
+	}
+
+	char buf[64];
+	if (end - start == 1)
+		snprintf(buf, 64, "%llu pointers to %#llx", (unsigned long long)total, (unsigned long long)start);
+	else
+		snprintf(buf, 64, "%llu pointers into %#llx", (unsigned long long)total, (unsigned long long)start);
+
+	labels.resize(refs.size() + 1);
+	labels[0] = buf;
+
+	for (int i = 0; i < refs.size(); i++) {
+		snprintf(buf, 64, "%#llx", (unsigned long long)refs[i]);
+		labels[i+1] = buf;
+	}
+
+	// the labels have all been made by now, so their c_str()s won't move
+	items.push_back({FLAG_INACTIVE, (char*)labels[0].c_str(), nullptr});
+	for (int i = 0; i < refs.size(); i++)
+		items.push_back({0, (char*)labels[i+1].c_str(), action});
+}
+
+void view_source_ref_handler(Workspace& ws, Box *box) {
+	auto ui = dynamic_cast<View_Source*>(box);
+	int idx = ws.rclick_menu.hl - 1;
+	if (idx < 0 || idx >= ui->refs.size())
+		return;
+
+	u64 address = ui->refs[idx];
+	ui->goto_address(address);
+	if (address >= ui->hex.region_address && address < ui->hex.region_address + ui->hex.region_size)
+		ui->hex.sel = address - ui->hex.region_address;
+}
+
+// Right-clicking shows what points to the selected byte
+void View_Source::prepare_rclick_menu(Context_Menu& menu, Camera& view, Point& cursor) {
+	rclick_menu_items.resize(0);
+	if (hex.sel < 0 || menu_type != MenuProcess)
+		return;
+
+	u64 address = hex.region_address + hex.sel;
+	make_pointer_refs_menu(hex.source, address, address + 1, refs, ref_labels, rclick_menu_items, view_source_ref_handler);
+}
+
 void View_Source::handle_zoom(Workspace& ws, float new_scale) {
 	cross.img = ws.cross;
 	maxm.img = ws.maxm;
@@ -0,0 +1,514 @@
+#include "muscles.h"
+#include "structs.h"
+#include "search.h"
+
+#include <algorithm>
+#include <atomic>
+
+// Offsets into glibc's malloc_state on 64-bit, from 2.27 onwards.
+// Older versions don't have 'have_fastchunks', so everything after 'flags' is 8 bytes earlier, which is what 'shift' is for.
+#define ARENA_FASTBINS    16
+#define ARENA_TOP         96
+#define ARENA_BINS        112
+#define ARENA_NEXT        2160
+#define ARENA_SYSTEM_MEM  2184
+#define ARENA_SIZE        2200
+
+#define N_FASTBINS   10
+#define TCACHE_BINS  64
+
+#define CHUNK_PREV_INUSE  1
+#define CHUNK_IS_MMAPPED  2
+#define CHUNK_SIZE_MASK   (~(u64)7)
+#define MIN_CHUNK_SIZE    32
+
+// Heaps that belong to arenas other than main_arena are aligned to this, so the heap_info at the start of one can be found from any address in it
+#define HEAP_MAX_SIZE (64 * 1024 * 1024)
+
+#define MAX_ARENAS       1024
+#define MAX_LIST_LENGTH  100000
+
+#define HEAP_READ_WINDOW (64 * 1024)
+
+// Reads the words the walk asks for out of a window of the process's memory, which only gets moved when a word isn't in it
+struct Heap_Reader {
+	SOURCE_HANDLE handle;
+	int pid;
+	u64 base;
+	int size;
+	u8 *buf;
+
+	bool read(u64 address, u64& value);
+};
+
+bool Heap_Reader::read(u64 address, u64& value) {
+	if (address < base || address - base + sizeof(u64) > size) {
+		Span spans[HEAP_READ_WINDOW / PAGE_SIZE];
+		base = address & ~(u64)(PAGE_SIZE - 1);
+
+		for (int i = 0; i < HEAP_READ_WINDOW / PAGE_SIZE; i++) {
+			spans[i] = {
+				.data = &buf[i * PAGE_SIZE],
+				.address = base + (u64)i * PAGE_SIZE,
+				.size = PAGE_SIZE
+			};
+		}
+		read_spans(handle, SourceProcess, pid, spans, HEAP_READ_WINDOW / PAGE_SIZE);
+
+		// the window only goes up to the first page that couldn't be read
+		size = 0;
+		for (int i = 0; i < HEAP_READ_WINDOW / PAGE_SIZE && spans[i].retrieved == PAGE_SIZE; i++)
+			size += PAGE_SIZE;
+
+		if (address - base + sizeof(u64) > size)
+			return false;
+	}
+
+	memcpy(&value, &buf[address - base], sizeof(u64));
+	return true;
+}
+
+struct Heap_Walk {
+	Heap_Reader reader;
+	std::vector<Heap_Chunk> *chunks;
+	std::vector<std::pair<u64, u64>> heaps; // the parts of the process that arenas' chunks were found in
+	int shift;
+};
+
+static const char *get_file_name(const char *path) {
+	const char *name = path;
+	for (const char *p = path; *p; p++) {
+		if (*p == '/')
+			name = p + 1;
+	}
+	return name;
+}
+
+void find_heap_areas(std::vector<Region> const& regions, std::vector<Heap_Area>& areas) {
+	areas.resize(0);
+
+	const u32 rw = (1 << REG_PM_READ) | (1 << REG_PM_WRITE);
+	bool after_libc = false;
+
+	for (auto& reg : regions) {
+		bool is_libc = false;
+		if (reg.name) {
+			const char *name = get_file_name(reg.name);
+			is_libc = !strncmp(name, "libc.", 5) || !strncmp(name, "libc-", 5);
+		}
+
+		if ((reg.flags & rw) == rw) {
+			int type = -1;
+			if (reg.name && !strcmp(reg.name, "[heap]"))
+				type = HEAP_AREA_BRK;
+			// main_arena is in glibc's .data, but its .bss comes straight after it in an anonymous mapping, so that gets checked too
+			else if (is_libc || (after_libc && !reg.name))
+				type = HEAP_AREA_LIBC;
+			else if (!reg.name)
+				type = HEAP_AREA_ANON;
+
+			// the kernel doesn't always merge neighbouring mappings (eg. [heap] can be split in two), but the walk needs them in one piece
+			if (type >= 0 && areas.size() > 0 && areas.back().type == type && areas.back().base + areas.back().size == reg.base)
+				areas.back().size += reg.size;
+			else if (type >= 0)
+				areas.push_back({reg.base, reg.size, type});
+		}
+
+		after_libc = is_libc;
+	}
+}
+
+// Adds each chunk from 'start' up to (but not including) 'top', or to where the chunks stop making sense.
+// Whether a chunk is in use is kept in the chunk after it.
+static void walk_chunks(Heap_Walk& walk, u64 start, u64 end, u64 top) {
+	auto& chunks = *walk.chunks;
+	int prev = -1;
+	u64 addr = start;
+
+	while (addr + HEAP_CHUNK_HEADER <= end) {
+		u64 size_field;
+		if (!walk.reader.read(addr + sizeof(u64), size_field))
+			break;
+
+		if (prev >= 0 && (size_field & CHUNK_PREV_INUSE))
+			chunks[prev].flags |= HEAP_CHUNK_IN_USE;
+
+		u64 size = size_field & CHUNK_SIZE_MASK;
+		if (addr == top || size < MIN_CHUNK_SIZE || size > end - addr)
+			break;
+
+		prev = chunks.size();
+		chunks.push_back({addr, size, 0});
+		addr += size;
+	}
+
+	walk.heaps.push_back(std::make_pair(start, addr));
+}
+
+static bool is_main_arena(Heap_Walk& walk, u64 arena, const Heap_Area& brk, u64 top, u64 top_end) {
+	int shift = walk.shift;
+	u64 next, system_mem, fd, bk;
+
+	if (!walk.reader.read(arena + ARENA_NEXT - shift, next) || !next || (next & 7))
+		return false;
+	if (!walk.reader.read(arena + ARENA_SYSTEM_MEM - shift, system_mem))
+		return false;
+
+	// main_arena's memory is all of [heap] up to the end of the top chunk, give or take the alignment of the first chunk
+	if (top_end - brk.base < system_mem || top_end - brk.base - system_mem >= PAGE_SIZE)
+		return false;
+
+	// the unsorted bin is either empty, in which case it points to itself, or it points into [heap]
+	u64 bin = arena + ARENA_BINS - shift - HEAP_CHUNK_HEADER;
+	if (!walk.reader.read(bin + HEAP_CHUNK_HEADER, fd) || !walk.reader.read(bin + HEAP_CHUNK_HEADER + sizeof(u64), bk))
+		return false;
+
+	bool in_heap = fd - brk.base < brk.size && bk - brk.base < brk.size;
+	return (fd == bin && bk == bin) || in_heap;
+}
+
+// Looks through glibc's data for a malloc_state whose top chunk is the one at the end of [heap]
+static u64 find_main_arena(Heap_Walk& walk, std::vector<Heap_Area> const& areas, const Heap_Area& brk, u64 top, u64 top_end) {
+	for (auto& area : areas) {
+		if (area.type != HEAP_AREA_LIBC)
+			continue;
+
+		for (u64 addr = area.base; addr + sizeof(u64) <= area.base + area.size; addr += sizeof(u64)) {
+			u64 value;
+			if (!walk.reader.read(addr, value))
+				break;
+			if (value != top)
+				continue;
+
+			for (int shift = 0; shift <= 8; shift += 8) {
+				u64 arena = addr - (ARENA_TOP - shift);
+				walk.shift = shift;
+				if (arena >= area.base && is_main_arena(walk, arena, brk, top, top_end))
+					return arena;
+			}
+		}
+	}
+
+	walk.shift = 0;
+	return 0;
+}
+
+// Every heap of an arena other than main_arena starts with a heap_info, which is 32 bytes until 2.35 and 48 after that.
+// The first chunk of a heap always has its previous-in-use bit set, which is enough to tell which it is.
+static u64 find_first_chunk(Heap_Walk& walk, u64 heap, u64 heap_end) {
+	for (u64 offset = 32; offset <= 48; offset += 16) {
+		u64 size_field;
+		if (!walk.reader.read(heap + offset + sizeof(u64), size_field))
+			continue;
+
+		u64 size = size_field & CHUNK_SIZE_MASK;
+		if ((size_field & CHUNK_PREV_INUSE) && size >= MIN_CHUNK_SIZE && size <= heap_end - heap - offset)
+			return heap + offset;
+	}
+
+	return 0;
+}
+
+static void walk_arena_heaps(Heap_Walk& walk, u64 arena) {
+	u64 top;
+	if (!walk.reader.read(arena + ARENA_TOP - walk.shift, top) || !top)
+		return;
+
+	u64 first_heap = arena & ~(u64)(HEAP_MAX_SIZE - 1);
+	u64 heap = top & ~(u64)(HEAP_MAX_SIZE - 1);
+
+	// heaps are linked from the newest (which has the top chunk) back to the oldest (which has the arena)
+	for (int i = 0; heap && i < HEAP_MAX_SIZE / PAGE_SIZE; i++) {
+		u64 prev, size;
+		if (!walk.reader.read(heap + sizeof(u64), prev) || !walk.reader.read(heap + 2 * sizeof(u64), size))
+			break;
+		if (size > HEAP_MAX_SIZE)
+			break;
+
+		u64 start = heap == first_heap ?
+			(arena + ARENA_SIZE - walk.shift + 15) & ~(u64)15 :
+			find_first_chunk(walk, heap, heap + size);
+
+		if (start)
+			walk_chunks(walk, start, heap + size, top);
+
+		if (heap == first_heap)
+			break;
+		heap = prev;
+	}
+}
+
+// Chunks that were too big for any arena are mmapped by themselves. The kernel can merge neighbouring ones into one mapping, so the walk carries on past the first.
+static void find_mmapped_chunks(Heap_Walk& walk, const Heap_Area& area) {
+	u64 addr = area.base;
+	while (addr + HEAP_CHUNK_HEADER <= area.base + area.size) {
+		u64 prev_size, size_field;
+		if (!walk.reader.read(addr, prev_size) || !walk.reader.read(addr + sizeof(u64), size_field))
+			break;
+
+		u64 size = size_field & CHUNK_SIZE_MASK;
+		if (prev_size != 0 || !(size_field & CHUNK_IS_MMAPPED) || size < PAGE_SIZE || (size & (PAGE_SIZE - 1)) || size > area.base + area.size - addr)
+			break;
+
+		walk.chunks->push_back({addr, size, HEAP_CHUNK_IN_USE | HEAP_CHUNK_MMAPPED});
+		addr += size;
+	}
+}
+
+static Heap_Chunk *find_chunk_at(std::vector<Heap_Chunk>& chunks, u64 address) {
+	auto it = std::lower_bound(chunks.begin(), chunks.end(), address, [](const Heap_Chunk& c, u64 addr) {
+		return c.address < addr;
+	});
+
+	return it != chunks.end() && it->address == address ? &*it : nullptr;
+}
+
+// Since 2.32, the links in tcaches and fastbins are xor'd with where they're stored, shifted down by 12 bits.
+// Whichever of the two readings leads to a chunk that was walked (or to the end of the list) is the right one.
+static u64 follow_free_link(Heap_Walk& walk, u64 link_addr, u64 stored, u64 offset) {
+	u64 demangled = (link_addr >> 12) ^ stored;
+	if (!demangled || find_chunk_at(*walk.chunks, demangled - offset))
+		return demangled;
+	if (!stored || find_chunk_at(*walk.chunks, stored - offset))
+		return stored;
+
+	return 0;
+}
+
+static void mark_free_list(Heap_Walk& walk, u64 first, u64 offset, int max_length) {
+	u64 entry = first;
+	for (int i = 0; entry && i < max_length; i++) {
+		Heap_Chunk *chunk = find_chunk_at(*walk.chunks, entry - offset);
+		if (!chunk)
+			break;
+
+		chunk->flags &= ~HEAP_CHUNK_IN_USE;
+
+		// the link is where the allocation would start, whether the list points to chunks (fastbins) or to allocations (tcaches)
+		u64 stored;
+		if (!walk.reader.read(chunk->address + HEAP_CHUNK_HEADER, stored))
+			break;
+
+		entry = follow_free_link(walk, chunk->address + HEAP_CHUNK_HEADER, stored, offset);
+	}
+}
+
+// Each thread's tcache is a chunk of its own, holding a count and a list for each size. It looks in use, as do all the chunks in it.
+// A chunk is only taken to be a tcache if every list in it starts at a chunk that was walked.
+static void mark_tcache(Heap_Walk& walk, const Heap_Chunk& chunk) {
+	bool wide_counts = chunk.size == 0x290; // 16-bit counts from 2.30, 8-bit before that
+	if (!wide_counts && chunk.size != 0x250)
+		return;
+
+	u64 counts_addr = chunk.address + HEAP_CHUNK_HEADER;
+	u64 entries_addr = counts_addr + (wide_counts ? 2 : 1) * TCACHE_BINS;
+
+	u64 entries[TCACHE_BINS];
+	int counts[TCACHE_BINS];
+
+	for (int i = 0; i < TCACHE_BINS; i++) {
+		if (!walk.reader.read(entries_addr + i * sizeof(u64), entries[i]))
+			return;
+		if (entries[i] && !find_chunk_at(*walk.chunks, entries[i] - HEAP_CHUNK_HEADER))
+			return;
+	}
+
+	for (int i = 0; i < TCACHE_BINS; i += 8 / (wide_counts ? 2 : 1)) {
+		u64 word;
+		if (!walk.reader.read(counts_addr + i * (wide_counts ? 2 : 1), word))
+			return;
+
+		for (int j = 0; j < 8 / (wide_counts ? 2 : 1); j++)
+			counts[i + j] = wide_counts ? (int)((word >> (j * 16)) & 0xffff) : (int)((word >> (j * 8)) & 0xff);
+	}
+
+	for (int i = 0; i < TCACHE_BINS; i++) {
+		if ((counts[i] == 0) != (entries[i] == 0))
+			return;
+	}
+
+	for (int i = 0; i < TCACHE_BINS; i++)
+		mark_free_list(walk, entries[i], HEAP_CHUNK_HEADER, counts[i]);
+}
+
+bool walk_glibc_heap(SOURCE_HANDLE handle, int pid, std::vector<Heap_Area> const& areas, std::vector<Heap_Chunk>& chunks) {
+	chunks.resize(0);
+
+	Heap_Walk walk;
+	walk.reader = {
+		.handle = handle,
+		.pid = pid,
+		.base = 0,
+		.size = 0,
+		.buf = new u8[HEAP_READ_WINDOW]
+	};
+	walk.chunks = &chunks;
+	walk.shift = 0;
+
+	std::vector<u64> arenas;
+
+	for (auto& area : areas) {
+		if (area.type != HEAP_AREA_BRK)
+			continue;
+
+		// the last chunk in [heap] is main_arena's top chunk, which is what gives away where main_arena is
+		walk_chunks(walk, area.base, area.base + area.size, 0);
+		if (chunks.size() == 0)
+			continue;
+
+		Heap_Chunk top = chunks.back();
+		chunks.pop_back();
+
+		u64 main_arena = find_main_arena(walk, areas, area, top.address, top.address + top.size);
+		if (main_arena) {
+			arenas.push_back(main_arena);
+
+			u64 arena = main_arena;
+			for (int i = 0; i < MAX_ARENAS; i++) {
+				if (!walk.reader.read(arena + ARENA_NEXT - walk.shift, arena) || !arena || arena == main_arena)
+					break;
+
+				arenas.push_back(arena);
+				walk_arena_heaps(walk, arena);
+			}
+		}
+		break;
+	}
+
+	std::sort(walk.heaps.begin(), walk.heaps.end());
+
+	for (auto& area : areas) {
+		if (area.type != HEAP_AREA_ANON)
+			continue;
+
+		auto it = std::lower_bound(walk.heaps.begin(), walk.heaps.end(), std::make_pair(area.base + area.size, (u64)0));
+		bool in_heap = it != walk.heaps.begin() && area.base < (it - 1)->second;
+		if (!in_heap)
+			find_mmapped_chunks(walk, area);
+	}
+
+	std::sort(chunks.begin(), chunks.end(), [](const Heap_Chunk& a, const Heap_Chunk& b) {
+		return a.address < b.address;
+	});
+
+	for (u64 arena : arenas) {
+		for (int i = 0; i < N_FASTBINS; i++) {
+			u64 first;
+			if (walk.reader.read(arena + ARENA_FASTBINS - walk.shift + i * sizeof(u64), first))
+				mark_free_list(walk, first, 0, MAX_LIST_LENGTH);
+		}
+	}
+
+	for (auto& c : chunks) {
+		if ((c.flags & HEAP_CHUNK_IN_USE) && (c.size == 0x290 || c.size == 0x250))
+			mark_tcache(walk, c);
+	}
+
+	delete[] walk.reader.buf;
+	return chunks.size() > 0;
+}
+
+const Heap_Chunk *find_heap_chunk(std::vector<Heap_Chunk> const& chunks, u64 address) {
+	auto it = std::upper_bound(chunks.begin(), chunks.end(), address, [](u64 addr, const Heap_Chunk& c) {
+		return addr < c.address;
+	});
+
+	if (it == chunks.begin() || address - (it - 1)->address >= (it - 1)->size)
+		return nullptr;
+
+	return &*(it - 1);
+}
+
+// The heap is walked on a thread of its own, since a big heap can take long enough to hold up the UI.
+// While that thread is busy, it only reads 'areas' and writes 'next_chunks', and the UI thread only reads 'chunks'.
+struct Heap_Cache {
+	SOURCE_HANDLE handle;
+	int pid;
+	int walked_at; // the source's timer when the last walk was picked up
+	bool walked; // whether 'chunks' holds a finished walk yet
+
+	std::vector<Heap_Area> areas;
+	std::vector<Heap_Chunk> chunks;
+	std::vector<Heap_Chunk> next_chunks;
+
+	void *thread;
+	std::atomic<bool> busy;
+};
+
+static void start_heap_walk(Heap_Cache& cache, Source& source) {
+	find_heap_areas(source.regions, cache.areas);
+	cache.busy = true;
+
+	auto func = [](void *data) {
+		auto cache = (Heap_Cache*)data;
+		walk_glibc_heap(cache->handle, cache->pid, cache->areas, cache->next_chunks);
+		cache->busy = false;
+		return (THREAD_RETURN_TYPE)0;
+	};
+	if (!start_thread(&cache.thread, &cache, func)) {
+		cache.thread = nullptr;
+		cache.busy = false;
+	}
+}
+
+// Called every tick. Like update_pointer_index(), this never waits for the walk: it only picks up the last one and starts the next one when it's due.
+void update_heap_cache(Source& source) {
+	Heap_Cache *cache = source.heap_cache;
+	if (!cache || cache->busy)
+		return;
+
+	if (cache->thread) {
+		join_thread(cache->thread);
+		cache->thread = nullptr;
+
+		cache->chunks.swap(cache->next_chunks);
+		cache->walked = true;
+		cache->walked_at = source.timer;
+	}
+
+	if (source.timer - cache->walked_at >= HEAP_WALK_TICKS)
+		start_heap_walk(*cache, source);
+}
+
+const Heap_Chunk *find_source_heap_chunk(Source& source, u64 address) {
+	if (source.type != SourceProcess)
+		return nullptr;
+
+	Heap_Cache *cache = source.heap_cache;
+	if (!cache) {
+		SOURCE_HANDLE handle = get_readonly_process_handle(source.pid);
+		if (!handle)
+			return nullptr;
+
+		cache = new Heap_Cache();
+		cache->handle = handle;
+		cache->pid = source.pid;
+		cache->walked_at = source.timer;
+		cache->walked = false;
+		cache->thread = nullptr;
+		cache->busy = false;
+		source.heap_cache = cache;
+
+		start_heap_walk(*cache, source);
+	}
+
+	// until the first walk is done, there's nothing to say which chunk the address is in
+	if (!cache->walked)
+		return nullptr;
+
+	return find_heap_chunk(cache->chunks, address);
+}
+
+void close_heap_cache(Source& source) {
+	Heap_Cache *cache = source.heap_cache;
+	if (!cache)
+		return;
+
+	if (cache->thread)
+		join_thread(cache->thread);
+
+	close_readonly_handle(cache->handle);
+	delete cache;
+
+	source.heap_cache = nullptr;
+}
@@ -6,6 +6,21 @@
 #include <dirent.h>
 #include <errno.h>
 #include <unistd.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+
+#include <atomic>
+#include <vector>
+
+#if __has_include(<linux/io_uring.h>)
+	#include <linux/io_uring.h>
+	#include <sys/syscall.h>
+	#define HAVE_IO_URING 1
+#endif
+
+// Set once process_vm_readv has been refused, after which process memory is read through /proc/<pid>/mem
+static std::atomic<bool> vm_readv_denied(false);
 
 #define PROC_NAME_MAX 512
 
@@ -243,20 +258,412 @@ void refresh_file_region(Source& source) {
 	reg.flags = (s.st_mode & S_IRWXU) / S_IXUSR;
 }
 
+// Spans that follow on from each other both in the source and in the destination are read together
+static void pread_spans(int fd, Span *spans, int n_spans) {
+	int i = 0;
+	while (i < n_spans) {
+		s64 size = spans[i].size > 0 ? spans[i].size : 0;
+		int run = 1;
+		while (i + run < n_spans && size < INT_MAX) {
+			Span& prev = spans[i + run - 1];
+			Span& next = spans[i + run];
+			if (next.address != prev.address + prev.size || next.data != prev.data + prev.size)
+				break;
+
+			size += next.size > 0 ? next.size : 0;
+			run++;
+		}
+
+		ssize_t res = size > 0 ? pread64(fd, spans[i].data, size, spans[i].address) : 0;
+		int j = 0;
+		for (; j < run; j++) {
+			int span_size = spans[i + j].size > 0 ? spans[i + j].size : 0;
+			if (res < span_size)
+				break;
+
+			spans[i + j].retrieved = span_size;
+			res -= span_size;
+		}
+
+		// the run came up short somewhere, so whatever's left is read one span at a time
+		for (; j < run; j++) {
+			Span& s = spans[i + j];
+			res = s.size > 0 ? pread64(fd, s.data, s.size, s.address) : 0;
+			s.retrieved = res > 0 ? (int)res : 0;
+		}
+
+		i += run;
+	}
+}
+
+#ifdef HAVE_IO_URING
+
+// How many reads each thread keeps in flight, and how big each of them can be.
+// Runs of spans bigger than URING_MAX_READ are split up, so that one big block becomes several reads that the drive can work on at once.
+#define URING_DEPTH     64
+#define URING_MAX_READ  (1024 * 1024)
+
+// Set once io_uring turns out not to be there (too old, disabled by sysctl, or blocked by seccomp), after which files are read with pread
+static std::atomic<bool> uring_denied(false);
+
+// The queues are shared with the kernel through mmap. Only one thread ever submits to a ring, so there's one per thread.
+struct Uring {
+	int fd = -1;
+
+	u32 *sq_head, *sq_tail, *sq_mask, *sq_array;
+	u32 *cq_head, *cq_tail, *cq_mask;
+	io_uring_sqe *sqes;
+	io_uring_cqe *cqes;
+
+	void *sq_ring = nullptr;
+	void *cq_ring = nullptr;
+	void *sqe_map = nullptr;
+	size_t sq_ring_size = 0;
+	size_t cq_ring_size = 0;
+	size_t sqe_map_size = 0;
+
+	bool init();
+	void release();
+	~Uring();
+};
+
+bool Uring::init() {
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	fd = (int)syscall(__NR_io_uring_setup, URING_DEPTH, &params);
+	if (fd < 0)
+		return false;
+
+	sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+	cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+	// newer kernels put both rings in the same mapping
+	bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single_mmap && cq_ring_size > sq_ring_size)
+		sq_ring_size = cq_ring_size;
+
+	sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sq_ring == MAP_FAILED) {
+		sq_ring = nullptr;
+		release();
+		return false;
+	}
+
+	if (single_mmap) {
+		cq_ring = sq_ring;
+	}
+	else {
+		cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cq_ring == MAP_FAILED) {
+			cq_ring = nullptr;
+			release();
+			return false;
+		}
+	}
+
+	sqe_map_size = params.sq_entries * sizeof(io_uring_sqe);
+	sqe_map = mmap(nullptr, sqe_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sqe_map == MAP_FAILED) {
+		sqe_map = nullptr;
+		release();
+		return false;
+	}
+
+	sqes = (io_uring_sqe*)sqe_map;
+
+	char *sq = (char*)sq_ring;
+	sq_head  = (u32*)&sq[params.sq_off.head];
+	sq_tail  = (u32*)&sq[params.sq_off.tail];
+	sq_mask  = (u32*)&sq[params.sq_off.ring_mask];
+	sq_array = (u32*)&sq[params.sq_off.array];
+
+	char *cq = (char*)cq_ring;
+	cq_head = (u32*)&cq[params.cq_off.head];
+	cq_tail = (u32*)&cq[params.cq_off.tail];
+	cq_mask = (u32*)&cq[params.cq_off.ring_mask];
+	cqes    = (io_uring_cqe*)&cq[params.cq_off.cqes];
+
+	return true;
+}
+
+// Every mapping has to go before the ring itself does, since each one keeps the ring alive even after its fd is closed
+void Uring::release() {
+	if (sqe_map)
+		munmap(sqe_map, sqe_map_size);
+	if (cq_ring && cq_ring != sq_ring)
+		munmap(cq_ring, cq_ring_size);
+	if (sq_ring)
+		munmap(sq_ring, sq_ring_size);
+	if (fd >= 0)
+		close(fd);
+
+	sqe_map = nullptr;
+	cq_ring = nullptr;
+	sq_ring = nullptr;
+	fd = -1;
+}
+
+Uring::~Uring() {
+	release();
+}
+
+struct Uring_Read {
+	struct iovec iov;
+	u64 offset;
+	int run;
+	int result;
+};
+
+struct Uring_Run {
+	int first; // index of the first span
+	int count;
+	s64 size;
+	s64 read; // how much of the run came back before the first short read
+};
+
+// Reads the spans through this thread's ring, keeping up to URING_DEPTH reads in flight at once.
+// Spans are grouped into runs the same way as pread_spans() does, and each run that comes up short is left for pread to finish off.
+// Returns false if the ring couldn't be used, in which case nothing has been filled in.
+static bool uring_read_spans(int fd, Span *spans, int n_spans) {
+	static thread_local Uring ring;
+
+	if (uring_denied)
+		return false;
+
+	// a ring that didn't set up properly never gets used, since this stops anything from trying again
+	if (ring.fd < 0 && !ring.init()) {
+		uring_denied = true;
+		return false;
+	}
+
+	std::vector<Uring_Run> runs;
+	std::vector<Uring_Read> reads;
+
+	int i = 0;
+	while (i < n_spans) {
+		s64 size = spans[i].size > 0 ? spans[i].size : 0;
+		int run = 1;
+		while (i + run < n_spans) {
+			Span& prev = spans[i + run - 1];
+			Span& next = spans[i + run];
+			if (next.address != prev.address + prev.size || next.data != prev.data + prev.size)
+				break;
+
+			size += next.size > 0 ? next.size : 0;
+			run++;
+		}
+
+		int run_idx = runs.size();
+		runs.push_back({.first = i, .count = run, .size = size, .read = 0});
+
+		for (s64 off = 0; off < size; off += URING_MAX_READ) {
+			s64 len = size - off < URING_MAX_READ ? size - off : URING_MAX_READ;
+			reads.push_back({
+				.iov = {.iov_base = spans[i].data + off, .iov_len = (size_t)len},
+				.offset = spans[i].address + off,
+				.run = run_idx,
+				.result = 0
+			});
+		}
+
+		i += run;
+	}
+
+	int n_reads = reads.size();
+	int submitted = 0;
+	int completed = 0;
+	bool broken = false;
+
+	while (completed < submitted || (submitted < n_reads && !broken)) {
+		u32 tail = *ring.sq_tail;
+		u32 mask = *ring.sq_mask;
+
+		while (!broken && submitted < n_reads && submitted - completed < URING_DEPTH) {
+			Uring_Read& r = reads[submitted];
+			u32 idx = tail & mask;
+
+			io_uring_sqe& sqe = ring.sqes[idx];
+			memset(&sqe, 0, sizeof(sqe));
+			sqe.opcode = IORING_OP_READV;
+			sqe.fd = fd;
+			sqe.off = r.offset;
+			sqe.addr = (u64)&r.iov;
+			sqe.len = 1;
+			sqe.user_data = (u64)submitted;
+
+			ring.sq_array[idx] = idx;
+			tail++;
+			submitted++;
+		}
+
+		__atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+		u32 pending = tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+
+		int res = 0;
+		if (!broken)
+			res = (int)syscall(__NR_io_uring_enter, ring.fd, pending, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+		if (res < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+			// Reads the kernel hasn't taken yet can be taken back, but reads it already has will still write into the spans,
+			//  so those have to be waited for before anything else touches them
+			tail -= pending;
+			submitted -= pending;
+			__atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+
+			if (submitted == 0) {
+				uring_denied = true;
+				return false;
+			}
+			broken = true;
+		}
+		else if (broken) {
+			wait_ms(1);
+		}
+
+		u32 head = *ring.cq_head;
+		u32 cq_tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+		while (head != cq_tail) {
+			io_uring_cqe& cqe = ring.cqes[head & *ring.cq_mask];
+			reads[cqe.user_data].result = cqe.res;
+			head++;
+			completed++;
+		}
+		__atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	// reads that never made it to the kernel come up short, which leaves their runs for pread
+	for (int k = submitted; k < n_reads; k++)
+		reads[k].result = -1;
+
+	// a run has only been read as far as its first short read
+	std::vector<bool> short_run(runs.size(), false);
+	for (auto& r : reads) {
+		Uring_Run& run = runs[r.run];
+		if (short_run[r.run])
+			continue;
+
+		if (r.result > 0)
+			run.read += r.result;
+		if (r.result < (int)r.iov.iov_len)
+			short_run[r.run] = true;
+	}
+
+	for (int k = 0; k < (int)runs.size(); k++) {
+		Uring_Run& run = runs[k];
+		s64 left = run.read;
+
+		int j = 0;
+		for (; j < run.count; j++) {
+			Span& s = spans[run.first + j];
+			int span_size = s.size > 0 ? s.size : 0;
+			if (left < span_size)
+				break;
+
+			s.retrieved = span_size;
+			left -= span_size;
+		}
+
+		if (j < run.count)
+			pread_spans(fd, &spans[run.first + j], run.count - j);
+	}
+
+	return true;
+}
+
+#endif
+
+// Regular files are read through io_uring where it's available, so that scattered pages can be fetched in parallel
+static void read_file_spans(int fd, Span *spans, int n_spans) {
+#ifdef HAVE_IO_URING
+	if (uring_read_spans(fd, spans, n_spans))
+		return;
+#endif
+
+	pread_spans(fd, spans, n_spans);
+}
+
+// Reads as many spans as possible with process_vm_readv, returning the number of spans that were dealt with.
+// If the kernel won't allow it (Yama, seccomp, or just too old), then this sets vm_readv_denied
+//  and the caller has to read the rest through /proc/<pid>/mem instead.
+static int vm_read_spans(int pid, Span *spans, int n_spans) {
+	if (vm_readv_denied)
+		return 0;
+
+	struct iovec local[IOV_MAX];
+	struct iovec remote[IOV_MAX];
+
+	int i = 0;
+	while (i < n_spans) {
+		int n = 0;
+		for (; n < IOV_MAX && i + n < n_spans; n++) {
+			Span& s = spans[i + n];
+			int size = s.size > 0 ? s.size : 0;
+			local[n] = {.iov_base = s.data, .iov_len = (size_t)size};
+			remote[n] = {.iov_base = (void*)s.address, .iov_len = (size_t)size};
+		}
+
+		ssize_t res = process_vm_readv(pid, local, n, remote, n, 0);
+		if (res < 0) {
+			if (errno == EPERM || errno == ENOSYS) {
+				vm_readv_denied = true;
+				return i;
+			}
+			if (errno == ESRCH) {
+				for (; i < n_spans; i++)
+					spans[i].retrieved = 0;
+				return n_spans;
+			}
+
+			// the first span couldn't be read at all, so skip past it
+			spans[i++].retrieved = 0;
+			continue;
+		}
+
+		int j = 0;
+		for (; j < n && res >= (ssize_t)local[j].iov_len; j++) {
+			spans[i + j].retrieved = local[j].iov_len;
+			res -= local[j].iov_len;
+		}
+
+		// process_vm_readv stops at the first span it can't read in full
+		if (j < n)
+			spans[i + j++].retrieved = (int)res;
+
+		i += j;
+	}
+
+	return n_spans;
+}
+
 void refresh_file_spans(Source& source, std::vector<Span>& input) {
 	if (source.fd <= 0)
 		source.fd = open((char*)source.identifier, O_RDONLY);
 
-	s64 offset;
-	for (auto& s : input) {
-		if (s.size <= 0)
-			continue;
+	for (auto& s : input)
+		s.data = &source.buffer[s.offset];
 
-		offset = s.address;
-		lseek64(source.fd, offset, SEEK_SET);
+	read_file_spans(source.fd, input.data(), input.size());
+}
 
-		s.retrieved = read(source.fd, &source.buffer[s.offset], s.size);
-	}
+// Works out what a region is from the last part of its line in /proc/<pid>/maps, which is a path, something in brackets, or nothing at all
+static RegionType get_region_type(const char *name, int pms) {
+	if (pms == 0)
+		return RegionGuard;
+	if (!name)
+		return RegionAnon;
+	if (name[0] == '/')
+		return RegionImage;
+
+	if (!strcmp(name, "[heap]"))
+		return RegionHeap;
+	if (!strncmp(name, "[stack", 6))
+		return RegionStack;
+	if (!strcmp(name, "[vdso]") || !strncmp(name, "[vvar", 5) || !strcmp(name, "[vsyscall]"))
+		return RegionSystem;
+
+	// eg. "[anon:name]", from prctl(PR_SET_VMA_ANON_NAME)
+	return RegionAnon;
 }
 
 void refresh_process_regions(Source& source) {
@@ -364,7 +771,8 @@ void refresh_process_regions(Source& source) {
 					.name = name,
 					.base = start,
 					.size = end - start,
-					.flags = (u32)pms
+					.flags = (u32)pms,
+					.type = get_region_type(name, pms)
 				});
 
 				mode = 0;
@@ -380,6 +788,14 @@ void refresh_process_regions(Source& source) {
 }
 
 void refresh_process_spans(Source& source, std::vector<Span>& input) {
+	for (auto& s : input)
+		s.data = &source.buffer[s.offset];
+
+	int done = vm_read_spans(source.pid, input.data(), input.size());
+	if (done >= input.size())
+		return;
+
+	// /proc/<pid>/mem is only needed if process_vm_readv isn't allowed
 	char mem_path[32];
 	snprintf(mem_path, 32, "/proc/%d/mem", source.pid);
 
@@ -390,16 +806,13 @@ void refresh_process_spans(Source& source, std::vector<Span>& input) {
 			snprintf(msg, 128, "Error: could not open %s", mem_path);
 			sdl_log_string(msg);
 
-			for (auto& s : input)
-				s.retrieved = 0;
+			for (int i = done; i < input.size(); i++)
+				input[i].retrieved = 0;
 			return;
 		}
 	}
 
-	for (auto& s : input) {
-		lseek64(source.fd, s.address, SEEK_SET);
-		s.retrieved = read(source.fd, (void*)&source.buffer[s.offset], s.size);
-	}
+	pread_spans(source.fd, &input[done], input.size() - done);
 }
 
 void close_source(Source& source) {
@@ -422,11 +835,187 @@ SOURCE_HANDLE get_readonly_process_handle(int pid) {
 	return fd > 0 ? fd : 0;
 }
 
+void close_readonly_handle(SOURCE_HANDLE handle) {
+	if (handle > 0)
+		close(handle);
+}
+
 int read_page(SOURCE_HANDLE handle, SourceType type, u64 address, char *buf) {
 	lseek64(handle, address, SEEK_SET);
 	return read(handle, buf, PAGE_SIZE);
 }
 
+void read_spans(SOURCE_HANDLE handle, SourceType type, int pid, Span *spans, int n_spans) {
+	int done = 0;
+	if (type == SourceProcess)
+		done = vm_read_spans(pid, spans, n_spans);
+
+	if (type == SourceFile)
+		read_file_spans(handle, spans, n_spans);
+	else if (done < n_spans)
+		pread_spans(handle, &spans[done], n_spans - done);
+}
+
+u64 get_file_size(SOURCE_HANDLE handle) {
+	struct stat s;
+	if (fstat(handle, &s) != 0 || !S_ISREG(s.st_mode))
+		return 0;
+
+	return (u64)s.st_size;
+}
+
+// The view is populated straight away, so that when it's a stream's spare block, its pages are faulted in on the helper thread.
+// Sequential access also makes the kernel read further ahead, which the views after this one benefit from.
+// If the file gets truncated while it's mapped, touching a page past the new end raises SIGBUS.
+void *map_file_view(SOURCE_HANDLE handle, u64 offset, u64 size) {
+	if (size == 0)
+		return nullptr;
+
+	void *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, handle, (off_t)offset);
+	if (view == MAP_FAILED)
+		return nullptr;
+
+	madvise(view, size, MADV_SEQUENTIAL);
+	return view;
+}
+
+void unmap_file_view(void *view, u64 size) {
+	if (view)
+		munmap(view, size);
+}
+
+// Each 64-bit entry in /proc/<pid>/pagemap describes one page
+#define PM_PRESENT   (1ULL << 63)
+#define PM_SWAPPED   (1ULL << 62)
+#define PM_SOFT_DIRTY (1ULL << 55)
+#define PM_PFN_MASK  ((1ULL << 55) - 1)
+
+#define PAGE_MAP_BATCH 512
+
+// Finds the frame of the shared zero page, which is what an untouched page in a private mapping gets mapped to when it's read.
+// Frame numbers are only visible with CAP_SYS_ADMIN (otherwise they all read as 0), in which case this also gives 0.
+static u64 find_zero_pfn() {
+	int fd = open("/proc/self/pagemap", O_RDONLY);
+	if (fd <= 0)
+		return 0;
+
+	u64 pfn = 0;
+	void *page = mmap(nullptr, PAGE_SIZE, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (page != MAP_FAILED) {
+		volatile u8 c = *(volatile u8*)page;
+		(void)c;
+
+		u64 entry = 0;
+		if (pread64(fd, &entry, sizeof(u64), ((u64)page / PAGE_SIZE) * sizeof(u64)) == sizeof(u64) && (entry & PM_PRESENT))
+			pfn = entry & PM_PFN_MASK;
+
+		munmap(page, PAGE_SIZE);
+	}
+
+	close(fd);
+	return pfn;
+}
+
+SOURCE_HANDLE get_page_map_handle(int pid) {
+	char path[32];
+	snprintf(path, 32, "/proc/%d/pagemap", pid);
+	int fd = open(path, O_RDONLY);
+	return fd > 0 ? fd : 0;
+}
+
+bool read_page_states(SOURCE_HANDLE page_map, u64 address, int n_pages, u8 *states) {
+	static const u64 zero_pfn = find_zero_pfn();
+
+	u64 entries[PAGE_MAP_BATCH];
+	u64 first = address / PAGE_SIZE;
+
+	for (int i = 0; i < n_pages; i += PAGE_MAP_BATCH) {
+		int n = n_pages - i < PAGE_MAP_BATCH ? n_pages - i : PAGE_MAP_BATCH;
+		ssize_t res = pread64(page_map, entries, n * sizeof(u64), (first + i) * sizeof(u64));
+		if (res != n * sizeof(u64))
+			return false;
+
+		for (int j = 0; j < n; j++) {
+			u64 e = entries[j];
+			if (!(e & (PM_PRESENT | PM_SWAPPED)))
+				states[i + j] = PAGE_ABSENT;
+			else if (zero_pfn && (e & PM_PRESENT) && (e & PM_PFN_MASK) == zero_pfn)
+				states[i + j] = PAGE_ZERO;
+			else
+				states[i + j] = PAGE_PRESENT;
+		}
+	}
+
+	return true;
+}
+
+// Kernels without CONFIG_MEM_SOFT_DIRTY still accept writes to clear_refs, but never set the bit, which would make every page look unwritten.
+// When soft-dirty tracking is there, a page that has just been written to always has the bit set, so that's what this checks for.
+static bool probe_soft_dirty() {
+	int fd = open("/proc/self/pagemap", O_RDONLY);
+	if (fd <= 0)
+		return false;
+
+	bool supported = false;
+	void *page = mmap(nullptr, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (page != MAP_FAILED) {
+		*(volatile u8*)page = 1;
+
+		u64 entry = 0;
+		if (pread64(fd, &entry, sizeof(u64), ((u64)page / PAGE_SIZE) * sizeof(u64)) == sizeof(u64))
+			supported = (entry & PM_PRESENT) && (entry & PM_SOFT_DIRTY);
+
+		munmap(page, PAGE_SIZE);
+	}
+
+	close(fd);
+	return supported;
+}
+
+bool clear_soft_dirty(int pid) {
+	static const bool supported = probe_soft_dirty();
+	if (!supported)
+		return false;
+
+	char path[32];
+	snprintf(path, 32, "/proc/%d/clear_refs", pid);
+	int fd = open(path, O_WRONLY);
+	if (fd <= 0)
+		return false;
+
+	bool ok = write(fd, "4", 1) == 1;
+	close(fd);
+	return ok;
+}
+
+// Pages that are close together are looked up with one read, rather than one read each
+bool read_soft_dirty(SOURCE_HANDLE page_map, const u64 *addresses, int n_pages, u8 *written) {
+	u64 entries[PAGE_MAP_BATCH];
+
+	int i = 0;
+	while (i < n_pages) {
+		u64 first = addresses[i] / PAGE_SIZE;
+		int run = 1;
+		while (i + run < n_pages && addresses[i + run] / PAGE_SIZE - first < PAGE_MAP_BATCH)
+			run++;
+
+		int n = (int)(addresses[i + run - 1] / PAGE_SIZE - first) + 1;
+		ssize_t res = pread64(page_map, entries, n * sizeof(u64), first * sizeof(u64));
+		if (res != n * sizeof(u64))
+			return false;
+
+		// a page that isn't there any more might have been dropped (eg. MADV_DONTNEED), so it only counts as clean if it's still around
+		for (int j = 0; j < run; j++) {
+			u64 e = entries[addresses[i + j] / PAGE_SIZE - first];
+			written[i + j] = !(e & (PM_PRESENT | PM_SWAPPED)) || (e & PM_SOFT_DIRTY);
+		}
+
+		i += run;
+	}
+
+	return true;
+}
+
 void wait_ms(int ms) {
 	usleep(ms * 1000);
 }
@@ -435,3 +1024,11 @@ bool start_thread(void **thread_ptr, void *data, THREAD_RETURN_TYPE (*function)(
 	int res = pthread_create((pthread_t*)thread_ptr, nullptr, function, data);
 	return res == 0;
 }
+
+void join_thread(void *thread) {
+	pthread_join((pthread_t)thread, nullptr);
+}
+
+int get_cpu_count() {
+	return (int)sysconf(_SC_NPROCESSORS_ONLN);
+}
@@ -349,6 +349,11 @@ void refresh_process_regions(Source& source) {
 
 		u32 flags = (pm_read << REG_PM_READ) | (pm_write << REG_PM_WRITE) | (pm_exec << REG_PM_EXEC);
 
+		// guard pages were already skipped, and telling a thread's stack apart from any other private memory would mean looking at every thread
+		RegionType type = RegionAnon;
+		if (info.Type == MEM_IMAGE || info.Type == MEM_MAPPED)
+			type = RegionImage;
+
 		Bucket& b = source.address_to_region.insert(reinterpret_cast<const char*>(base), sizeof(u64));
 		b.value = source.regions.size();
 
@@ -356,7 +361,8 @@ void refresh_process_regions(Source& source) {
 			.name = nullptr,
 			.base = base,
 			.size = size,
-			.flags = flags
+			.flags = flags,
+			.type = type
 		});
 
 		base += info.RegionSize;
@@ -423,6 +429,11 @@ SOURCE_HANDLE get_readonly_process_handle(int pid) {
 	return OpenProcess(PROCESS_ALL_ACCESS, false, pid);
 }
 
+void close_readonly_handle(SOURCE_HANDLE handle) {
+	if (handle && handle != INVALID_HANDLE_VALUE)
+		CloseHandle(handle);
+}
+
 int read_page(SOURCE_HANDLE handle, SourceType type, u64 address, char *buf) {
 	int retrieved = 0;
 	if (type == SourceFile) {
@@ -442,11 +453,105 @@ int read_page(SOURCE_HANDLE handle, SourceType type, u64 address, char *buf) {
 	return retrieved;
 }
 
+u64 get_file_size(SOURCE_HANDLE handle) {
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(handle, &size))
+		return 0;
+
+	return (u64)size.QuadPart;
+}
+
+static u64 get_allocation_granularity() {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwAllocationGranularity;
+}
+
+// Views have to start on a multiple of the allocation granularity (64 KB), which is coarser than a page.
+// The view is started that much earlier, so the returned pointer is partway into it.
+void *map_file_view(SOURCE_HANDLE handle, u64 offset, u64 size) {
+	static const u64 granularity = get_allocation_granularity();
+	if (size == 0)
+		return nullptr;
+
+	HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+		return nullptr;
+
+	u64 base = offset - (offset % granularity);
+	u64 lead = offset - base;
+	void *view = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)(base >> 32), (DWORD)base, (SIZE_T)(size + lead));
+
+	// the view keeps the mapping open by itself
+	CloseHandle(mapping);
+
+	return view ? (void*)((char*)view + lead) : nullptr;
+}
+
+void unmap_file_view(void *view, u64 size) {
+	static const u64 granularity = get_allocation_granularity();
+	if (view)
+		UnmapViewOfFile((void*)((u64)view - ((u64)view % granularity)));
+}
+
+// There's no page table to read on Windows, so the resident-only option has no effect here and every page is read as usual
+SOURCE_HANDLE get_page_map_handle(int pid) {
+	return (SOURCE_HANDLE)0;
+}
+
+bool read_page_states(SOURCE_HANDLE page_map, u64 address, int n_pages, u8 *states) {
+	return false;
+}
+
+bool clear_soft_dirty(int pid) {
+	return false;
+}
+
+bool read_soft_dirty(SOURCE_HANDLE page_map, const u64 *addresses, int n_pages, u8 *written) {
+	return false;
+}
+
+// There's no vectored version of ReadProcessMemory, so each span gets its own call
+void read_spans(SOURCE_HANDLE handle, SourceType type, int pid, Span *spans, int n_spans) {
+	for (int i = 0; i < n_spans; i++) {
+		Span& s = spans[i];
+		s.retrieved = 0;
+		if (s.size <= 0)
+			continue;
+
+		if (type == SourceFile) {
+			LARGE_INTEGER offset;
+			offset.QuadPart = (LONGLONG)s.address;
+			SetFilePointerEx(handle, offset, nullptr, FILE_BEGIN);
+
+			DWORD r = 0;
+			ReadFile(handle, s.data, s.size, &r, nullptr);
+			s.retrieved = (int)r;
+		}
+		else if (type == SourceProcess) {
+			SIZE_T r = 0;
+			ReadProcessMemory(handle, (LPCVOID)s.address, (LPVOID)s.data, s.size, &r);
+			s.retrieved = (int)r;
+		}
+	}
+}
+
 void wait_ms(int ms) {
 	Sleep(ms);
 }
 
 bool start_thread(void **thread_ptr, void *data, THREAD_RETURN_TYPE (*function)(void*)) {
 	*thread_ptr = (HANDLE)CreateThread(nullptr, 0, function, data, 0, nullptr);
-	return *thread_ptr == nullptr;
+	return *thread_ptr != nullptr;
+}
+
+void join_thread(void *thread) {
+	WaitForSingleObject((HANDLE)thread, INFINITE);
+	CloseHandle((HANDLE)thread);
+}
+
+int get_cpu_count() {
+	SYSTEM_INFO info = {0};
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
 }
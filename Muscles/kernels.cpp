@@ -0,0 +1,569 @@
+#include "muscles.h"
+#include "structs.h"
+#include "search.h"
+#include "kernels.h"
+
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define KERNELS_X86
+#endif
+
+#ifdef KERNELS_X86
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define TARGET_AVX2
+	#else
+		#define TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+	#include <immintrin.h>
+#endif
+
+static int detect_simd_level() {
+#ifdef KERNELS_X86
+	#ifdef _MSC_VER
+		int regs[4];
+		__cpuid(regs, 1);
+		bool osxsave = (regs[2] & (1 << 27)) != 0;
+		bool avx = (regs[2] & (1 << 28)) != 0;
+
+		__cpuidex(regs, 7, 0);
+		bool avx2 = (regs[1] & (1 << 5)) != 0;
+
+		// the OS needs to save the upper halves of the ymm registers, or else we can't use them
+		if (osxsave && avx && avx2 && (_xgetbv(0) & 6) == 6)
+			return SIMD_AVX2;
+	#else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return SIMD_AVX2;
+	#endif
+	return SIMD_SSE2;
+#else
+	return SIMD_NONE;
+#endif
+}
+
+static int simd_level = detect_simd_level();
+
+int get_simd_level() {
+	return simd_level;
+}
+
+// Mask of the movemask bits that correspond to the first byte of each element in a vector of 'width' bytes
+template <typename T>
+static constexpr u32 lane_mask(int width) {
+	u32 pattern =
+		sizeof(T) == 1 ? 0xffffffff :
+		sizeof(T) == 2 ? 0x55555555 :
+		sizeof(T) == 4 ? 0x11111111 :
+		0x01010101;
+
+	return width >= 32 ? pattern : pattern & ((1U << width) - 1);
+}
+
+template <typename T>
+static constexpr T sign_bit() {
+	return (T)((T)1 << (T)(8 * sizeof(T) - 1));
+}
+
+template <int method, typename T>
+static int scan_block_scalar(const u8 *buf, int start, int size, T v1, T v2, u32 *out) {
+	int n = 0;
+	for (int i = start; i + (int)sizeof(T) <= size; i += sizeof(T)) {
+		T value = *(T*)(&buf[i]);
+		if constexpr (method == METHOD_EQUALS) {
+			if (value == v1)
+				out[n++] = i;
+		}
+		else {
+			if (value >= v1 && value <= v2)
+				out[n++] = i;
+		}
+	}
+	return n;
+}
+
+template <int method, typename T>
+static int compare_block_scalar(const u8 *cur, const u8 *prev, int start, int size, T delta, u32 *out) {
+	int n = 0;
+	for (int i = start; i + (int)sizeof(T) <= size; i += sizeof(T)) {
+		if (compare_values<method, T>(*(T*)(&cur[i]), *(T*)(&prev[i]), delta))
+			out[n++] = i;
+	}
+	return n;
+}
+
+#ifdef KERNELS_X86
+
+template <typename T>
+static inline __m128i sse2_set1(T v) {
+	if constexpr (std::is_same_v<T, float>)
+		return _mm_castps_si128(_mm_set1_ps(v));
+	else if constexpr (std::is_same_v<T, double>)
+		return _mm_castpd_si128(_mm_set1_pd(v));
+	else if constexpr (sizeof(T) == 1)
+		return _mm_set1_epi8((char)v);
+	else if constexpr (sizeof(T) == 2)
+		return _mm_set1_epi16((short)v);
+	else if constexpr (sizeof(T) == 4)
+		return _mm_set1_epi32((int)v);
+	else
+		return _mm_set1_epi64x((long long)v);
+}
+
+template <typename T>
+static inline __m128i sse2_equals(__m128i x, __m128i v) {
+	if constexpr (std::is_same_v<T, float>)
+		return _mm_castps_si128(_mm_cmpeq_ps(_mm_castsi128_ps(x), _mm_castsi128_ps(v)));
+	else if constexpr (std::is_same_v<T, double>)
+		return _mm_castpd_si128(_mm_cmpeq_pd(_mm_castsi128_pd(x), _mm_castsi128_pd(v)));
+	else if constexpr (sizeof(T) == 1)
+		return _mm_cmpeq_epi8(x, v);
+	else if constexpr (sizeof(T) == 2)
+		return _mm_cmpeq_epi16(x, v);
+	else if constexpr (sizeof(T) == 4)
+		return _mm_cmpeq_epi32(x, v);
+	else {
+		// SSE2 has no 64-bit compare, so both 32-bit halves have to match
+		__m128i eq = _mm_cmpeq_epi32(x, v);
+		return _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+	}
+}
+
+template <typename T>
+static inline __m128i sse2_greater(__m128i a, __m128i b) {
+	if constexpr (sizeof(T) == 1)
+		return _mm_cmpgt_epi8(a, b);
+	else if constexpr (sizeof(T) == 2)
+		return _mm_cmpgt_epi16(a, b);
+	else
+		return _mm_cmpgt_epi32(a, b);
+}
+
+// lo and hi are expected to already be biased if T is unsigned
+template <typename T>
+static inline __m128i sse2_in_range(__m128i x, __m128i lo, __m128i hi, __m128i bias) {
+	if constexpr (std::is_same_v<T, float>) {
+		__m128 xf = _mm_castsi128_ps(x);
+		return _mm_castps_si128(_mm_and_ps(_mm_cmpge_ps(xf, _mm_castsi128_ps(lo)), _mm_cmple_ps(xf, _mm_castsi128_ps(hi))));
+	}
+	else if constexpr (std::is_same_v<T, double>) {
+		__m128d xd = _mm_castsi128_pd(x);
+		return _mm_castpd_si128(_mm_and_pd(_mm_cmpge_pd(xd, _mm_castsi128_pd(lo)), _mm_cmple_pd(xd, _mm_castsi128_pd(hi))));
+	}
+	else {
+		if constexpr (std::is_unsigned_v<T>)
+			x = _mm_xor_si128(x, bias);
+
+		__m128i outside = _mm_or_si128(sse2_greater<T>(lo, x), sse2_greater<T>(x, hi));
+		return _mm_xor_si128(outside, _mm_set1_epi32(-1));
+	}
+}
+
+template <int method, typename T>
+static int scan_block_sse2(const u8 *buf, int size, T v1, T v2, u32 *out) {
+	// SSE2 can't compare 64-bit integers for order
+	if constexpr (method == METHOD_RANGE && std::is_integral_v<T> && sizeof(T) == 8) {
+		return scan_block_scalar<method, T>(buf, 0, size, v1, v2, out);
+	}
+	else {
+		const u32 lanes = lane_mask<T>(16);
+
+		__m128i bias = _mm_setzero_si128();
+		if constexpr (std::is_integral_v<T> && std::is_unsigned_v<T>)
+			bias = sse2_set1<T>(sign_bit<T>());
+
+		__m128i a = _mm_xor_si128(sse2_set1<T>(v1), method == METHOD_RANGE ? bias : _mm_setzero_si128());
+		__m128i b = _mm_xor_si128(sse2_set1<T>(v2), bias);
+
+		int n = 0;
+		int i = 0;
+		for (; i + 16 <= size; i += 16) {
+			__m128i x = _mm_loadu_si128((const __m128i*)&buf[i]);
+
+			__m128i hit;
+			if constexpr (method == METHOD_EQUALS)
+				hit = sse2_equals<T>(x, a);
+			else
+				hit = sse2_in_range<T>(x, a, b, bias);
+
+			u32 mask = (u32)_mm_movemask_epi8(hit) & lanes;
+			while (mask) {
+				out[n++] = i + lowest_bit(mask);
+				mask &= mask - 1;
+			}
+		}
+
+		return n + scan_block_scalar<method, T>(buf, i, size, v1, v2, &out[n]);
+	}
+}
+
+template <typename T>
+static inline __m128i sse2_sub(__m128i a, __m128i b) {
+	if constexpr (sizeof(T) == 1)
+		return _mm_sub_epi8(a, b);
+	else if constexpr (sizeof(T) == 2)
+		return _mm_sub_epi16(a, b);
+	else if constexpr (sizeof(T) == 4)
+		return _mm_sub_epi32(a, b);
+	else
+		return _mm_sub_epi64(a, b);
+}
+
+// 'bias' flips the sign bit of unsigned integers, so that they can be ordered with a signed compare
+template <int method, typename T>
+static inline __m128i sse2_compare(__m128i x, __m128i p, __m128i delta, __m128i bias) {
+	if constexpr (method == METHOD_CHANGED)
+		return _mm_xor_si128(sse2_equals<Bits_Of<T>>(x, p), _mm_set1_epi32(-1));
+	else if constexpr (method == METHOD_UNCHANGED)
+		return sse2_equals<Bits_Of<T>>(x, p);
+	else if constexpr (method == METHOD_CHANGED_BY) {
+		if constexpr (std::is_same_v<T, float>)
+			return sse2_equals<T>(x, _mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(p), _mm_castsi128_ps(delta))));
+		else if constexpr (std::is_same_v<T, double>)
+			return sse2_equals<T>(x, _mm_castpd_si128(_mm_add_pd(_mm_castsi128_pd(p), _mm_castsi128_pd(delta))));
+		else
+			return sse2_equals<T>(sse2_sub<T>(x, p), delta);
+	}
+	else {
+		__m128i a = method == METHOD_INCREASED ? x : p;
+		__m128i b = method == METHOD_INCREASED ? p : x;
+		if constexpr (std::is_same_v<T, float>)
+			return _mm_castps_si128(_mm_cmpgt_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b)));
+		else if constexpr (std::is_same_v<T, double>)
+			return _mm_castpd_si128(_mm_cmpgt_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b)));
+		else
+			return sse2_greater<T>(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias));
+	}
+}
+
+template <int method, typename T>
+static int compare_block_sse2(const u8 *cur, const u8 *prev, int size, T delta, u32 *out) {
+	constexpr bool ordered = method == METHOD_INCREASED || method == METHOD_DECREASED;
+	if constexpr (ordered && std::is_integral_v<T> && sizeof(T) == 8) {
+		return compare_block_scalar<method, T>(cur, prev, 0, size, delta, out);
+	}
+	else {
+		const u32 lanes = lane_mask<T>(16);
+
+		__m128i bias = _mm_setzero_si128();
+		if constexpr (std::is_integral_v<T> && std::is_unsigned_v<T>)
+			bias = sse2_set1<T>(sign_bit<T>());
+
+		__m128i d = sse2_set1<T>(delta);
+
+		int n = 0;
+		int i = 0;
+		for (; i + 16 <= size; i += 16) {
+			__m128i x = _mm_loadu_si128((const __m128i*)&cur[i]);
+			__m128i p = _mm_loadu_si128((const __m128i*)&prev[i]);
+
+			u32 mask = (u32)_mm_movemask_epi8(sse2_compare<method, T>(x, p, d, bias)) & lanes;
+			while (mask) {
+				out[n++] = i + lowest_bit(mask);
+				mask &= mask - 1;
+			}
+		}
+
+		return n + compare_block_scalar<method, T>(cur, prev, i, size, delta, &out[n]);
+	}
+}
+
+template <typename T>
+TARGET_AVX2 static inline __m256i avx2_set1(T v) {
+	if constexpr (std::is_same_v<T, float>)
+		return _mm256_castps_si256(_mm256_set1_ps(v));
+	else if constexpr (std::is_same_v<T, double>)
+		return _mm256_castpd_si256(_mm256_set1_pd(v));
+	else if constexpr (sizeof(T) == 1)
+		return _mm256_set1_epi8((char)v);
+	else if constexpr (sizeof(T) == 2)
+		return _mm256_set1_epi16((short)v);
+	else if constexpr (sizeof(T) == 4)
+		return _mm256_set1_epi32((int)v);
+	else
+		return _mm256_set1_epi64x((long long)v);
+}
+
+template <typename T>
+TARGET_AVX2 static inline __m256i avx2_equals(__m256i x, __m256i v) {
+	if constexpr (std::is_same_v<T, float>)
+		return _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(x), _mm256_castsi256_ps(v), _CMP_EQ_OQ));
+	else if constexpr (std::is_same_v<T, double>)
+		return _mm256_castpd_si256(_mm256_cmp_pd(_mm256_castsi256_pd(x), _mm256_castsi256_pd(v), _CMP_EQ_OQ));
+	else if constexpr (sizeof(T) == 1)
+		return _mm256_cmpeq_epi8(x, v);
+	else if constexpr (sizeof(T) == 2)
+		return _mm256_cmpeq_epi16(x, v);
+	else if constexpr (sizeof(T) == 4)
+		return _mm256_cmpeq_epi32(x, v);
+	else
+		return _mm256_cmpeq_epi64(x, v);
+}
+
+template <typename T>
+TARGET_AVX2 static inline __m256i avx2_greater(__m256i a, __m256i b) {
+	if constexpr (sizeof(T) == 1)
+		return _mm256_cmpgt_epi8(a, b);
+	else if constexpr (sizeof(T) == 2)
+		return _mm256_cmpgt_epi16(a, b);
+	else if constexpr (sizeof(T) == 4)
+		return _mm256_cmpgt_epi32(a, b);
+	else
+		return _mm256_cmpgt_epi64(a, b);
+}
+
+template <typename T>
+TARGET_AVX2 static inline __m256i avx2_in_range(__m256i x, __m256i lo, __m256i hi, __m256i bias) {
+	if constexpr (std::is_same_v<T, float>) {
+		__m256 xf = _mm256_castsi256_ps(x);
+		__m256 ge = _mm256_cmp_ps(xf, _mm256_castsi256_ps(lo), _CMP_GE_OQ);
+		__m256 le = _mm256_cmp_ps(xf, _mm256_castsi256_ps(hi), _CMP_LE_OQ);
+		return _mm256_castps_si256(_mm256_and_ps(ge, le));
+	}
+	else if constexpr (std::is_same_v<T, double>) {
+		__m256d xd = _mm256_castsi256_pd(x);
+		__m256d ge = _mm256_cmp_pd(xd, _mm256_castsi256_pd(lo), _CMP_GE_OQ);
+		__m256d le = _mm256_cmp_pd(xd, _mm256_castsi256_pd(hi), _CMP_LE_OQ);
+		return _mm256_castpd_si256(_mm256_and_pd(ge, le));
+	}
+	else {
+		if constexpr (std::is_unsigned_v<T>)
+			x = _mm256_xor_si256(x, bias);
+
+		__m256i outside = _mm256_or_si256(avx2_greater<T>(lo, x), avx2_greater<T>(x, hi));
+		return _mm256_xor_si256(outside, _mm256_set1_epi32(-1));
+	}
+}
+
+template <int method, typename T>
+TARGET_AVX2 static int scan_block_avx2(const u8 *buf, int size, T v1, T v2, u32 *out) {
+	const u32 lanes = lane_mask<T>(32);
+
+	__m256i bias = _mm256_setzero_si256();
+	if constexpr (std::is_integral_v<T> && std::is_unsigned_v<T>)
+		bias = avx2_set1<T>(sign_bit<T>());
+
+	__m256i a = _mm256_xor_si256(avx2_set1<T>(v1), method == METHOD_RANGE ? bias : _mm256_setzero_si256());
+	__m256i b = _mm256_xor_si256(avx2_set1<T>(v2), bias);
+
+	int n = 0;
+	int i = 0;
+	for (; i + 32 <= size; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)&buf[i]);
+
+		__m256i hit;
+		if constexpr (method == METHOD_EQUALS)
+			hit = avx2_equals<T>(x, a);
+		else
+			hit = avx2_in_range<T>(x, a, b, bias);
+
+		u32 mask = (u32)_mm256_movemask_epi8(hit) & lanes;
+		while (mask) {
+			out[n++] = i + lowest_bit(mask);
+			mask &= mask - 1;
+		}
+	}
+
+	return n + scan_block_scalar<method, T>(buf, i, size, v1, v2, &out[n]);
+}
+
+template <typename T>
+TARGET_AVX2 static inline __m256i avx2_sub(__m256i a, __m256i b) {
+	if constexpr (sizeof(T) == 1)
+		return _mm256_sub_epi8(a, b);
+	else if constexpr (sizeof(T) == 2)
+		return _mm256_sub_epi16(a, b);
+	else if constexpr (sizeof(T) == 4)
+		return _mm256_sub_epi32(a, b);
+	else
+		return _mm256_sub_epi64(a, b);
+}
+
+template <int method, typename T>
+TARGET_AVX2 static inline __m256i avx2_compare(__m256i x, __m256i p, __m256i delta, __m256i bias) {
+	if constexpr (method == METHOD_CHANGED)
+		return _mm256_xor_si256(avx2_equals<Bits_Of<T>>(x, p), _mm256_set1_epi32(-1));
+	else if constexpr (method == METHOD_UNCHANGED)
+		return avx2_equals<Bits_Of<T>>(x, p);
+	else if constexpr (method == METHOD_CHANGED_BY) {
+		if constexpr (std::is_same_v<T, float>)
+			return avx2_equals<T>(x, _mm256_castps_si256(_mm256_add_ps(_mm256_castsi256_ps(p), _mm256_castsi256_ps(delta))));
+		else if constexpr (std::is_same_v<T, double>)
+			return avx2_equals<T>(x, _mm256_castpd_si256(_mm256_add_pd(_mm256_castsi256_pd(p), _mm256_castsi256_pd(delta))));
+		else
+			return avx2_equals<T>(avx2_sub<T>(x, p), delta);
+	}
+	else {
+		__m256i a = method == METHOD_INCREASED ? x : p;
+		__m256i b = method == METHOD_INCREASED ? p : x;
+		if constexpr (std::is_same_v<T, float>)
+			return _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _CMP_GT_OQ));
+		else if constexpr (std::is_same_v<T, double>)
+			return _mm256_castpd_si256(_mm256_cmp_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b), _CMP_GT_OQ));
+		else
+			return avx2_greater<T>(_mm256_xor_si256(a, bias), _mm256_xor_si256(b, bias));
+	}
+}
+
+template <int method, typename T>
+TARGET_AVX2 static int compare_block_avx2(const u8 *cur, const u8 *prev, int size, T delta, u32 *out) {
+	const u32 lanes = lane_mask<T>(32);
+
+	__m256i bias = _mm256_setzero_si256();
+	if constexpr (std::is_integral_v<T> && std::is_unsigned_v<T>)
+		bias = avx2_set1<T>(sign_bit<T>());
+
+	__m256i d = avx2_set1<T>(delta);
+
+	int n = 0;
+	int i = 0;
+	for (; i + 32 <= size; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)&cur[i]);
+		__m256i p = _mm256_loadu_si256((const __m256i*)&prev[i]);
+
+		u32 mask = (u32)_mm256_movemask_epi8(avx2_compare<method, T>(x, p, d, bias)) & lanes;
+		while (mask) {
+			out[n++] = i + lowest_bit(mask);
+			mask &= mask - 1;
+		}
+	}
+
+	return n + compare_block_scalar<method, T>(cur, prev, i, size, delta, &out[n]);
+}
+
+#endif
+
+template <int method, typename T>
+int scan_block(const u8 *buf, int size, T v1, T v2, u32 *out) {
+#ifdef KERNELS_X86
+	if (simd_level >= SIMD_AVX2)
+		return scan_block_avx2<method, T>(buf, size, v1, v2, out);
+	if (simd_level >= SIMD_SSE2)
+		return scan_block_sse2<method, T>(buf, size, v1, v2, out);
+#endif
+	return scan_block_scalar<method, T>(buf, 0, size, v1, v2, out);
+}
+
+template <int method, typename T>
+int compare_block(const u8 *cur, const u8 *prev, int size, T delta, u32 *out) {
+#ifdef KERNELS_X86
+	if (simd_level >= SIMD_AVX2)
+		return compare_block_avx2<method, T>(cur, prev, size, delta, out);
+	if (simd_level >= SIMD_SSE2)
+		return compare_block_sse2<method, T>(cur, prev, size, delta, out);
+#endif
+	return compare_block_scalar<method, T>(cur, prev, 0, size, delta, out);
+}
+
+static int scan_pattern_scalar(const u8 *buf, int start, int size, const Byte_Pattern& pattern, u32 *out) {
+	const int a = pattern.anchors[0];
+	const u8 value = pattern.bytes[a];
+	const u8 mask = pattern.mask[a];
+
+	int n = 0;
+	for (int i = start; i + pattern.size <= size; i++) {
+		if ((buf[i + a] & mask) == value && pattern_matches(&buf[i], pattern))
+			out[n++] = i;
+	}
+	return n;
+}
+
+#ifdef KERNELS_X86
+
+// Each vector tests 16 starting points at once against both anchor bytes. Only the starting points that get past both are checked in full.
+static int scan_pattern_sse2(const u8 *buf, int size, const Byte_Pattern& pattern, u32 *out) {
+	const int a0 = pattern.anchors[0];
+	const int a1 = pattern.anchors[1];
+	const __m128i v0 = _mm_set1_epi8((char)pattern.bytes[a0]);
+	const __m128i m0 = _mm_set1_epi8((char)pattern.mask[a0]);
+	const __m128i v1 = _mm_set1_epi8((char)pattern.bytes[a1]);
+	const __m128i m1 = _mm_set1_epi8((char)pattern.mask[a1]);
+
+	// starting points [i, i + 16) are only tested together when the whole pattern fits after the last of them
+	const int end = size - pattern.size + 1;
+
+	int n = 0;
+	int i = 0;
+	for (; i + 16 <= end; i += 16) {
+		__m128i x0 = _mm_and_si128(_mm_loadu_si128((const __m128i*)&buf[i + a0]), m0);
+		__m128i x1 = _mm_and_si128(_mm_loadu_si128((const __m128i*)&buf[i + a1]), m1);
+		__m128i hit = _mm_and_si128(_mm_cmpeq_epi8(x0, v0), _mm_cmpeq_epi8(x1, v1));
+
+		u32 mask = (u32)_mm_movemask_epi8(hit);
+		while (mask) {
+			int pos = i + lowest_bit(mask);
+			if (pattern_matches(&buf[pos], pattern))
+				out[n++] = pos;
+			mask &= mask - 1;
+		}
+	}
+
+	return n + scan_pattern_scalar(buf, i, size, pattern, &out[n]);
+}
+
+TARGET_AVX2 static int scan_pattern_avx2(const u8 *buf, int size, const Byte_Pattern& pattern, u32 *out) {
+	const int a0 = pattern.anchors[0];
+	const int a1 = pattern.anchors[1];
+	const __m256i v0 = _mm256_set1_epi8((char)pattern.bytes[a0]);
+	const __m256i m0 = _mm256_set1_epi8((char)pattern.mask[a0]);
+	const __m256i v1 = _mm256_set1_epi8((char)pattern.bytes[a1]);
+	const __m256i m1 = _mm256_set1_epi8((char)pattern.mask[a1]);
+
+	const int end = size - pattern.size + 1;
+
+	int n = 0;
+	int i = 0;
+	for (; i + 32 <= end; i += 32) {
+		__m256i x0 = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)&buf[i + a0]), m0);
+		__m256i x1 = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)&buf[i + a1]), m1);
+		__m256i hit = _mm256_and_si256(_mm256_cmpeq_epi8(x0, v0), _mm256_cmpeq_epi8(x1, v1));
+
+		u32 mask = (u32)_mm256_movemask_epi8(hit);
+		while (mask) {
+			int pos = i + lowest_bit(mask);
+			if (pattern_matches(&buf[pos], pattern))
+				out[n++] = pos;
+			mask &= mask - 1;
+		}
+	}
+
+	return n + scan_pattern_scalar(buf, i, size, pattern, &out[n]);
+}
+
+#endif
+
+int scan_pattern(const u8 *buf, int size, const Byte_Pattern& pattern, u32 *out) {
+	if (pattern.size <= 0 || size < pattern.size)
+		return 0;
+
+#ifdef KERNELS_X86
+	if (simd_level >= SIMD_AVX2)
+		return scan_pattern_avx2(buf, size, pattern, out);
+	if (simd_level >= SIMD_SSE2)
+		return scan_pattern_sse2(buf, size, pattern, out);
+#endif
+	return scan_pattern_scalar(buf, 0, size, pattern, out);
+}
+
+#define INSTANTIATE_SCAN_BLOCK(T) \
+	template int scan_block<METHOD_EQUALS, T>(const u8*, int, T, T, u32*); \
+	template int scan_block<METHOD_RANGE, T>(const u8*, int, T, T, u32*); \
+	template int compare_block<METHOD_CHANGED, T>(const u8*, const u8*, int, T, u32*); \
+	template int compare_block<METHOD_UNCHANGED, T>(const u8*, const u8*, int, T, u32*); \
+	template int compare_block<METHOD_INCREASED, T>(const u8*, const u8*, int, T, u32*); \
+	template int compare_block<METHOD_DECREASED, T>(const u8*, const u8*, int, T, u32*); \
+	template int compare_block<METHOD_CHANGED_BY, T>(const u8*, const u8*, int, T, u32*);
+
+INSTANTIATE_SCAN_BLOCK(std::int8_t)
+INSTANTIATE_SCAN_BLOCK(std::int16_t)
+INSTANTIATE_SCAN_BLOCK(std::int32_t)
+INSTANTIATE_SCAN_BLOCK(std::int64_t)
+INSTANTIATE_SCAN_BLOCK(std::uint8_t)
+INSTANTIATE_SCAN_BLOCK(std::uint16_t)
+INSTANTIATE_SCAN_BLOCK(std::uint32_t)
+INSTANTIATE_SCAN_BLOCK(std::uint64_t)
+INSTANTIATE_SCAN_BLOCK(float)
+INSTANTIATE_SCAN_BLOCK(double)
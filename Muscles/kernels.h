@@ -0,0 +1,80 @@
+#pragma once
+
+#include <type_traits>
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
+
+#define SIMD_NONE 0
+#define SIMD_SSE2 1
+#define SIMD_AVX2 2
+
+// Detected once at startup. The widest instruction set that both the CPU and the OS support.
+int get_simd_level();
+
+// Finds every T at a multiple of sizeof(T) within buf[0, size) that satisfies 'method' (METHOD_EQUALS or METHOD_RANGE),
+//  writing the byte offset of each match into 'out', which needs room for (size / sizeof(T)) entries.
+// Returns the number of matches. Offsets are written in ascending order.
+template <int method, typename T>
+int scan_block(const u8 *buf, int size, T v1, T v2, u32 *out);
+
+// Like scan_block, but compares each T in 'cur' against the T at the same offset in 'prev', using one of the relative methods
+//  (METHOD_CHANGED through METHOD_CHANGED_BY). 'delta' is only used by METHOD_CHANGED_BY.
+template <int method, typename T>
+int compare_block(const u8 *cur, const u8 *prev, int size, T delta, u32 *out);
+
+// Finds every position in buf[0, size) where the whole of 'pattern' matches, writing them into 'out' in ascending order.
+// Only positions where the pattern fits inside the buffer are looked at, so 'out' needs room for (size - pattern.size + 1) entries.
+int scan_pattern(const u8 *buf, int size, const Byte_Pattern& pattern, u32 *out);
+
+static inline bool pattern_matches(const u8 *buf, const Byte_Pattern& pattern) {
+	for (int i = 0; i < pattern.size; i++) {
+		if ((buf[i] & pattern.mask[i]) != pattern.bytes[i])
+			return false;
+	}
+	return true;
+}
+
+// The unsigned integer type with the same size as T, so that floats can be compared by their bits
+template <typename T>
+using Bits_Of = std::conditional_t<std::is_same_v<T, float>, u32, std::conditional_t<std::is_same_v<T, double>, u64, T>>;
+
+// Changed and unchanged look at the bits rather than the value, so that a float which stays NaN counts as unchanged
+template <int method, typename T>
+static inline bool compare_values(T value, T prev, T delta) {
+	if constexpr (method == METHOD_CHANGED || method == METHOD_UNCHANGED) {
+		Bits_Of<T> a, b;
+		memcpy(&a, &value, sizeof(T));
+		memcpy(&b, &prev, sizeof(T));
+		return method == METHOD_CHANGED ? a != b : a == b;
+	}
+	else if constexpr (method == METHOD_INCREASED)
+		return value > prev;
+	else if constexpr (method == METHOD_DECREASED)
+		return value < prev;
+	else if constexpr (std::is_floating_point_v<T>)
+		return value == prev + delta;
+	else
+		return (T)(value - prev) == delta;
+}
+
+static inline int lowest_bit(u32 mask) {
+#ifdef _MSC_VER
+	unsigned long idx;
+	_BitScanForward(&idx, mask);
+	return (int)idx;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+static inline int lowest_bit(u64 mask) {
+#ifdef _MSC_VER
+	unsigned long idx;
+	_BitScanForward64(&idx, mask);
+	return (int)idx;
+#else
+	return __builtin_ctzll(mask);
+#endif
+}
@@ -448,12 +448,23 @@ struct Span {
 	u32 flags = 0;
 };
 
+enum RegionType {
+	RegionUnknown = 0,
+	RegionHeap,   // the brk heap
+	RegionStack,
+	RegionAnon,   // memory that isn't backed by a file, eg. from mmap() or VirtualAlloc()
+	RegionImage,  // mapped from a file, eg. an executable or a library
+	RegionSystem, // put there by the kernel, eg. [vdso]
+	RegionGuard   // can't be accessed at all
+};
+
 struct Region {
 	char *name = nullptr;
 	u64 base = 0;
 	u64 size = 0;
 	//u32 offset = 0;
 	u32 flags = 0;
+	RegionType type = RegionUnknown;
 };
 
 enum SourceType {
@@ -462,6 +473,9 @@ enum SourceType {
 	SourceProcess
 };
 
+struct Pointer_Index;
+struct Heap_Cache;
+
 struct Source {
 	SourceType type = SourceNone;
 	std::string name;
@@ -487,6 +501,12 @@ struct Source {
 	std::vector<Region> regions;
 	std::vector<Span> spans;
 
+	// built the first time something asks what points to an address in this source (see find_pointers_to())
+	Pointer_Index *pointer_index = nullptr;
+
+	// made the first time something asks which heap chunk an address is in (see find_source_heap_chunk())
+	Heap_Cache *heap_cache = nullptr;
+
 	bool region_refreshed = false;
 	bool block_region_refresh = false;
 
@@ -524,10 +544,43 @@ void close_source(Source& source);
 
 SOURCE_HANDLE get_readonly_file_handle(void *identifier);
 SOURCE_HANDLE get_readonly_process_handle(int pid);
+void close_readonly_handle(SOURCE_HANDLE handle);
 
 int read_page(SOURCE_HANDLE handle, SourceType type, u64 address, char *buf);
 
+// Reads each span's 'size' bytes from 'address' into 'data', setting 'retrieved' to how much could be read.
+// Spans are batched into as few system calls as possible. 'pid' is only used for processes.
+void read_spans(SOURCE_HANDLE handle, SourceType type, int pid, Span *spans, int n_spans);
+
+// Returns the size of an open file, or 0 if it can't be found
+u64 get_file_size(SOURCE_HANDLE handle);
+
+// Maps [offset, offset + size) of an open file read-only, so that it can be scanned without copying it, returning nullptr if that isn't possible.
+// 'offset' must be page-aligned, and the view must not go past the end of the file.
+void *map_file_view(SOURCE_HANDLE handle, u64 offset, u64 size);
+void unmap_file_view(void *view, u64 size);
+
+#define PAGE_ABSENT   0 // neither in memory nor swapped out, eg. reserved but never touched
+#define PAGE_PRESENT  1 // in memory or in swap
+#define PAGE_ZERO     2 // mapped to the shared zero page, so known to be all zeroes without reading it
+
+// Returns a handle to the process's page table, or 0 if there's no way to tell which pages are resident
+SOURCE_HANDLE get_page_map_handle(int pid);
+
+// Sets states[i] to one of the PAGE_* values above for each of the 'n_pages' pages from 'address'.
+// Returns false if the page table couldn't be read, in which case every page should be treated as present.
+bool read_page_states(SOURCE_HANDLE page_map, u64 address, int n_pages, u8 *states);
+
+// Starts tracking which pages the process writes to from now on. Returns false if that isn't possible.
+bool clear_soft_dirty(int pid);
+
+// Sets written[i] to whether the page at addresses[i] could have been written to since clear_soft_dirty().
+// 'addresses' must be page-aligned and ascending. Returns false if the page table couldn't be read.
+bool read_soft_dirty(SOURCE_HANDLE page_map, const u64 *addresses, int n_pages, u8 *written);
+
 void wait_ms(int ms);
 
 bool start_thread(void** thread_ptr, void *data, THREAD_RETURN_TYPE (*function)(void*));
+void join_thread(void *thread);
+int get_cpu_count();
 
@@ -0,0 +1,314 @@
+#include "muscles.h"
+#include "structs.h"
+#include "search.h"
+
+#include <algorithm>
+#include <cmath>
+
+static int hex_digit(char c) {
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+
+	return -1;
+}
+
+// A rough guess at how often a byte turns up in memory. Zero and 0xff are everywhere, small numbers and
+//  common x86-64 opcodes and prefixes are next, and everything else is assumed to be about equally rare.
+static double byte_frequency(int b) {
+	if (b == 0x00)
+		return 64.0;
+	if (b == 0xff)
+		return 16.0;
+	if (b < 0x10)
+		return 4.0;
+
+	switch (b) {
+		case 0x20: case 0x24: case 0x40: case 0x44: case 0x48: case 0x49: case 0x4c: case 0x4d:
+		case 0x83: case 0x89: case 0x8b: case 0x8d: case 0xc0: case 0xc3: case 0xcc: case 0xe8:
+			return 2.0;
+	}
+
+	if (b >= 'a' && b <= 'z')
+		return 1.5;
+
+	return 1.0;
+}
+
+// How likely a byte at this position is to match by chance
+static double match_frequency(u8 value, u8 mask) {
+	double freq = 0;
+	for (int b = 0; b < 256; b++) {
+		if ((b & mask) == value)
+			freq += byte_frequency(b);
+	}
+	return freq;
+}
+
+static void pick_anchors(Byte_Pattern& pattern) {
+	double best[2] = {1e30, 1e30};
+	pattern.anchors[0] = -1;
+	pattern.anchors[1] = -1;
+
+	for (int i = 0; i < pattern.size; i++) {
+		if (pattern.mask[i] == 0)
+			continue;
+
+		double freq = match_frequency(pattern.bytes[i], pattern.mask[i]);
+		if (freq < best[0]) {
+			best[1] = best[0];
+			pattern.anchors[1] = pattern.anchors[0];
+			best[0] = freq;
+			pattern.anchors[0] = i;
+		}
+		else if (freq < best[1]) {
+			best[1] = freq;
+			pattern.anchors[1] = i;
+		}
+	}
+
+	// with only one byte to go on, both anchors are the same byte
+	if (pattern.anchors[1] < 0)
+		pattern.anchors[1] = pattern.anchors[0];
+}
+
+// How likely a pattern is to match at any given position by chance, as a log so that long patterns don't round down to 0
+static double pattern_log_frequency(const Byte_Pattern& pattern) {
+	double total = match_frequency(0, 0);
+	double log_freq = 0;
+	for (int i = 0; i < pattern.size; i++)
+		log_freq += log(match_frequency(pattern.bytes[i], pattern.mask[i]) / total);
+
+	return log_freq;
+}
+
+bool make_value_group(const Search_Parameter *values, int n_values, int window, bool ordered, Value_Group& group) {
+	group.n_values = 0;
+	if (n_values <= 0 || n_values > MAX_GROUP_VALUES || window <= 0 || window > MAX_GROUP_WINDOW)
+		return false;
+
+	int total_size = 0;
+	for (int i = 0; i < n_values; i++) {
+		const Search_Parameter& v = values[i];
+		Byte_Pattern& pattern = group.values[i];
+
+		int size = v.size / 8;
+		if ((size != 1 && size != 2 && size != 4 && size != 8) || size > window)
+			return false;
+
+		// floats are always given as doubles
+		if ((v.flags & FLAG_FLOAT) && size == 4) {
+			float f = (float)*(double*)&v.value1;
+			memcpy(pattern.bytes, &f, 4);
+		}
+		else
+			memcpy(pattern.bytes, &v.value1, size);
+
+		memset(pattern.mask, 0xff, size);
+		pattern.size = size;
+		pattern.label = nullptr;
+		pick_anchors(pattern);
+
+		total_size += size;
+	}
+
+	// values can't overlap, so they all have to fit in the window one after the other
+	if (total_size > window)
+		return false;
+
+	double freqs[MAX_GROUP_VALUES];
+	for (int i = 0; i < n_values; i++) {
+		freqs[i] = pattern_log_frequency(group.values[i]);
+		group.order[i] = i;
+	}
+
+	auto& vals = group.values;
+	std::sort(group.order, group.order + n_values, [&](int a, int b) {
+		if (freqs[a] != freqs[b])
+			return freqs[a] < freqs[b];
+		if (vals[a].size != vals[b].size)
+			return vals[a].size < vals[b].size;
+		int cmp = memcmp(vals[a].bytes, vals[b].bytes, vals[a].size);
+		return cmp < 0 || (cmp == 0 && a < b);
+	});
+
+	for (int i = 0; i < n_values; i++) {
+		int a = group.order[i];
+		int b = i > 0 ? group.order[i-1] : -1;
+		group.same_as_prev[i] = b >= 0 && vals[a].size == vals[b].size && memcmp(vals[a].bytes, vals[b].bytes, vals[a].size) == 0;
+	}
+
+	group.anchor = group.order[0];
+
+	group.n_values = n_values;
+	group.window = window;
+	group.ordered = ordered;
+	return true;
+}
+
+bool parse_byte_pattern(const char *str, Byte_Pattern& pattern) {
+	pattern.size = 0;
+	pattern.label = nullptr;
+	if (!str)
+		return false;
+
+	bool any_known = false;
+	const char *p = str;
+
+	while (*p) {
+		if (*p == ' ' || *p == '\t' || *p == ',') {
+			p++;
+			continue;
+		}
+
+		if (pattern.size >= MAX_PATTERN_BYTES)
+			return false;
+
+		u8 value = 0;
+		u8 mask = 0;
+
+		// a lone '?' stands for a whole byte
+		if (p[0] == '?' && (p[1] == 0 || p[1] == ' ' || p[1] == '\t' || p[1] == ',')) {
+			p++;
+		}
+		else {
+			for (int i = 0; i < 2; i++, p++) {
+				value <<= 4;
+				mask <<= 4;
+
+				if (*p == '?')
+					continue;
+
+				int digit = hex_digit(*p);
+				if (digit < 0)
+					return false;
+
+				value |= digit;
+				mask |= 0xf;
+			}
+		}
+
+		pattern.bytes[pattern.size] = value;
+		pattern.mask[pattern.size] = mask;
+		pattern.size++;
+
+		if (mask)
+			any_known = true;
+	}
+
+	if (!any_known) {
+		pattern.size = 0;
+		return false;
+	}
+
+	pick_anchors(pattern);
+	return true;
+}
+
+// Returns the code point at str, moving str past it, or -1 if it isn't valid UTF-8
+static int decode_utf8(const u8*& str) {
+	int c = *str++;
+	if (c < 0x80)
+		return c;
+
+	int n_extra = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : -1;
+	if (n_extra < 0 || c >= 0xf8)
+		return -1;
+
+	int cp = c & (0x3f >> n_extra);
+	for (int i = 0; i < n_extra; i++) {
+		c = *str;
+		if ((c & 0xc0) != 0x80)
+			return -1;
+
+		cp = (cp << 6) | (c & 0x3f);
+		str++;
+	}
+
+	return cp <= 0x10ffff ? cp : -1;
+}
+
+// Letters whose upper and lower case forms only differ by 0x20
+static bool is_foldable(int cp) {
+	return (cp >= 'A' && cp <= 'Z') || (cp >= 'a' && cp <= 'z') ||
+		(cp >= 0xc0 && cp <= 0xfe && cp != 0xd7 && cp != 0xdf && cp != 0xf7);
+}
+
+static bool add_pattern_byte(Byte_Pattern& pattern, u8 value, bool fold) {
+	if (pattern.size >= MAX_PATTERN_BYTES)
+		return false;
+
+	u8 mask = fold ? 0xdf : 0xff;
+	pattern.bytes[pattern.size] = value & mask;
+	pattern.mask[pattern.size] = mask;
+	pattern.size++;
+	return true;
+}
+
+int make_text_patterns(const char *str, int encoding, bool ignore_case, Byte_Pattern *patterns) {
+	if (!str || !str[0])
+		return 0;
+
+	Byte_Pattern& narrow = patterns[0];
+	Byte_Pattern& wide = encoding == TEXT_UTF16LE ? patterns[0] : patterns[1];
+	narrow.size = 0;
+	wide.size = 0;
+
+	bool do_narrow = encoding != TEXT_UTF16LE;
+	bool do_wide = encoding != TEXT_UTF8;
+	bool ascii = true;
+
+	const u8 *p = (const u8*)str;
+	while (*p) {
+		const u8 *start = p;
+		int cp = decode_utf8(p);
+		if (cp < 0)
+			return 0;
+
+		bool fold = ignore_case && is_foldable(cp);
+		if (cp >= 0x80)
+			ascii = false;
+
+		// in UTF-8, the case bit of a Latin-1 letter is in its second byte
+		if (do_narrow) {
+			for (const u8 *b = start; b < p; b++) {
+				if (!add_pattern_byte(narrow, *b, fold && b == p - 1))
+					return 0;
+			}
+		}
+
+		if (do_wide) {
+			u16 units[2];
+			int n_units = 1;
+			if (cp >= 0x10000) {
+				units[0] = 0xd800 + ((cp - 0x10000) >> 10);
+				units[1] = 0xdc00 + ((cp - 0x10000) & 0x3ff);
+				n_units = 2;
+			}
+			else
+				units[0] = cp;
+
+			for (int i = 0; i < n_units; i++) {
+				if (!add_pattern_byte(wide, units[i] & 0xff, fold) || !add_pattern_byte(wide, units[i] >> 8, false))
+					return 0;
+			}
+		}
+	}
+
+	int n_patterns = 0;
+	if (do_narrow) {
+		narrow.label = ascii ? "ASCII" : "UTF-8";
+		pick_anchors(narrow);
+		n_patterns++;
+	}
+	if (do_wide) {
+		wide.label = "UTF-16LE";
+		pick_anchors(wide);
+		n_patterns++;
+	}
+
+	return n_patterns;
+}
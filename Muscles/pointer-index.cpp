@@ -0,0 +1,346 @@
+#include "muscles.h"
+#include "structs.h"
+#include "search.h"
+#include "thread-pool.h"
+
+#include <algorithm>
+
+// The index is made of blocks that are rescanned separately, so that keeping it up to date is spread out over many ticks
+#define POINTER_INDEX_BLOCK (1024 * 1024)
+#define POINTER_INDEX_BLOCKS_PER_TICK 2
+
+// Each pointer is kept as its value plus where it is relative to the start of its block, which takes 12 bytes instead of 16
+struct Pointer_Block {
+	u64 start;
+	u64 end;
+	u64 hash; // of what was in the block when it was last scanned, which most of the time is still there
+	bool scanned;
+	std::vector<u64> values; // sorted
+	std::vector<u32> offsets; // in the same order as 'values'
+};
+
+struct Pointer_Ref {
+	u64 value;
+	u32 offset;
+};
+
+// What the indexing thread found in one of the pending blocks, which the UI thread moves into the block once the thread is done
+struct Pointer_Block_Scan {
+	u64 hash;
+	bool changed;
+	std::vector<u64> values;
+	std::vector<u32> offsets;
+};
+
+// The blocks are scanned on a thread of their own, so that indexing a big process doesn't hold up the UI.
+// While that thread is busy, it only reads the blocks and 'ranges', and the UI thread only reads 'values' and 'offsets'.
+struct Pointer_Index {
+	SOURCE_HANDLE handle;
+	int pid;
+
+	std::vector<Pointer_Block> blocks; // in address order
+	std::vector<std::pair<u64, u64>> ranges; // the readable regions, which is where a value has to point to count as a pointer
+	int next_block;
+
+	bool ready; // set once every block has been scanned for the first time
+	bool regions_changed; // the regions were refreshed while the thread was busy, so the blocks get laid out again once it's done
+
+	void *thread;
+	std::atomic<bool> busy;
+	std::atomic<bool> cancelled;
+	int n_workers;
+
+	std::vector<int> pending; // the blocks being scanned by the thread
+	std::vector<Pointer_Block_Scan> scans; // one for each pending block
+	u8 *buffers[MAX_WORKERS];
+	std::vector<Pointer_Ref> refs[MAX_WORKERS];
+};
+
+void scan_pointer_block(void *data, int worker, int idx) {
+	auto index = (Pointer_Index*)data;
+	if (index->cancelled)
+		return;
+
+	const Pointer_Block& block = index->blocks[index->pending[idx]];
+	Pointer_Block_Scan& scan = index->scans[idx];
+
+	if (!index->buffers[worker])
+		index->buffers[worker] = new u8[POINTER_INDEX_BLOCK];
+	u8 *buf = index->buffers[worker];
+
+	// each page is read separately, so that one page that can't be read doesn't lose the rest of the block
+	Span spans[POINTER_INDEX_BLOCK / PAGE_SIZE];
+	int n_pages = (int)((block.end - block.start + PAGE_SIZE - 1) / PAGE_SIZE);
+
+	for (int i = 0; i < n_pages; i++) {
+		u64 address = block.start + (u64)i * PAGE_SIZE;
+		spans[i] = {
+			.data = &buf[i * PAGE_SIZE],
+			.address = address,
+			.size = block.end - address < PAGE_SIZE ? (int)(block.end - address) : PAGE_SIZE
+		};
+	}
+
+	read_spans(index->handle, SourceProcess, index->pid, spans, n_pages);
+
+	u64 hash = 0;
+	for (int i = 0; i < n_pages; i++) {
+		const u64 *words = (const u64*)&buf[i * PAGE_SIZE];
+		int n_words = spans[i].retrieved / sizeof(u64);
+		for (int j = 0; j < n_words; j++)
+			hash = (hash ^ words[j]) * 0x100000001b3ULL;
+
+		hash = (hash ^ (u64)spans[i].retrieved) * 0x100000001b3ULL;
+	}
+
+	scan.hash = hash;
+	scan.changed = !block.scanned || hash != block.hash;
+	if (!scan.changed)
+		return;
+
+	const auto& ranges = index->ranges;
+	u64 lowest = ranges.front().first;
+	u64 highest = ranges.back().first + ranges.back().second;
+
+	auto& refs = index->refs[worker];
+	refs.resize(0);
+
+	for (int i = 0; i < n_pages; i++) {
+		int size = spans[i].retrieved & ~(int)(sizeof(u64) - 1);
+		for (int j = 0; j < size; j += sizeof(u64)) {
+			u64 value;
+			memcpy(&value, &buf[i * PAGE_SIZE + j], sizeof(u64));
+			if (value - lowest >= highest - lowest)
+				continue;
+
+			auto it = std::upper_bound(ranges.begin(), ranges.end(), value, [](u64 v, const std::pair<u64, u64>& r) {
+				return v < r.first;
+			});
+			if (it != ranges.begin() && value - (it - 1)->first < (it - 1)->second)
+				refs.push_back({value, (u32)(i * PAGE_SIZE + j)});
+		}
+	}
+
+	std::sort(refs.begin(), refs.end(), [](const Pointer_Ref& a, const Pointer_Ref& b) {
+		return a.value < b.value || (a.value == b.value && a.offset < b.offset);
+	});
+
+	// fresh vectors, so that a block that used to have more pointers in it gives back the memory
+	std::vector<u64> values(refs.size());
+	std::vector<u32> offsets(refs.size());
+	for (int i = 0; i < refs.size(); i++) {
+		values[i] = refs[i].value;
+		offsets[i] = refs[i].offset;
+	}
+
+	scan.values.swap(values);
+	scan.offsets.swap(offsets);
+}
+
+// Splits the readable regions into blocks. Blocks that are the same as before keep what was found in them, and the rest get scanned as soon as possible.
+static void layout_pointer_blocks(Pointer_Index& index, Source& source) {
+	std::vector<std::pair<u64, u64>> old_ranges;
+	old_ranges.swap(index.ranges);
+
+	for (auto& reg : source.regions) {
+		if (reg.flags & (1 << REG_PM_READ))
+			index.ranges.push_back(std::make_pair(reg.base, reg.size));
+	}
+
+	std::sort(index.ranges.begin(), index.ranges.end(), [](const std::pair<u64, u64>& a, const std::pair<u64, u64>& b) {
+		return a.first < b.first;
+	});
+
+	std::vector<Pointer_Block> blocks;
+	int old = 0;
+
+	for (auto& r : index.ranges) {
+		u64 addr = r.first;
+		u64 range_end = r.first + r.second;
+
+		while (addr < range_end) {
+			u64 next = (addr & ~(u64)(POINTER_INDEX_BLOCK - 1)) + POINTER_INDEX_BLOCK;
+			if (next > range_end || next <= addr)
+				next = range_end;
+
+			while (old < index.blocks.size() && index.blocks[old].start < addr)
+				old++;
+
+			if (old < index.blocks.size() && index.blocks[old].start == addr && index.blocks[old].end == next)
+				blocks.push_back(std::move(index.blocks[old]));
+			else
+				blocks.push_back({ .start = addr, .end = next, .hash = 0, .scanned = false });
+
+			addr = next;
+		}
+	}
+
+	index.blocks.swap(blocks);
+	if (index.next_block >= index.blocks.size())
+		index.next_block = 0;
+
+	// which values count as pointers depends on the ranges, so a block that hasn't changed still needs rescanning if they have
+	if (index.ranges != old_ranges) {
+		for (auto& b : index.blocks)
+			b.scanned = false;
+	}
+}
+
+static void start_pointer_scan(Pointer_Index& index, int n_workers) {
+	if (index.pending.size() == 0 || index.ranges.size() == 0) {
+		index.ready = true;
+		return;
+	}
+
+	index.scans.resize(0);
+	index.scans.resize(index.pending.size());
+	index.n_workers = n_workers;
+	index.busy = true;
+
+	auto func = [](void *data) {
+		auto index = (Pointer_Index*)data;
+		run_tasks(index, scan_pointer_block, index->pending.size(), index->n_workers);
+		index->busy = false;
+		return (THREAD_RETURN_TYPE)0;
+	};
+	if (!start_thread(&index.thread, &index, func)) {
+		index.thread = nullptr;
+		index.busy = false;
+	}
+}
+
+// Moves what the thread found into the blocks it scanned
+static void finish_pointer_scan(Pointer_Index& index) {
+	join_thread(index.thread);
+	index.thread = nullptr;
+
+	for (int i = 0; i < index.pending.size(); i++) {
+		Pointer_Block& block = index.blocks[index.pending[i]];
+		Pointer_Block_Scan& scan = index.scans[i];
+		if (!scan.changed)
+			continue;
+
+		block.values.swap(scan.values);
+		block.offsets.swap(scan.offsets);
+		block.hash = scan.hash;
+		block.scanned = true;
+	}
+
+	index.pending.resize(0);
+	index.ready = true;
+}
+
+// Called every tick. Nothing here waits for the indexing thread: this only picks up what it's done and gives it the next few blocks.
+void update_pointer_index(Source& source) {
+	Pointer_Index *index = source.pointer_index;
+	if (!index)
+		return;
+
+	if (source.region_refreshed)
+		index->regions_changed = true;
+
+	if (index->busy)
+		return;
+
+	if (index->thread)
+		finish_pointer_scan(*index);
+
+	if (index->regions_changed) {
+		layout_pointer_blocks(*index, source);
+		index->regions_changed = false;
+	}
+
+	int n_blocks = index->blocks.size();
+	index->pending.resize(0);
+
+	// blocks that have never been scanned (eg. from a region that's just appeared) come first
+	for (int i = 0; i < n_blocks && index->pending.size() < POINTER_INDEX_BLOCKS_PER_TICK; i++) {
+		if (!index->blocks[i].scanned)
+			index->pending.push_back(i);
+	}
+
+	for (int i = 0; i < n_blocks && index->pending.size() < POINTER_INDEX_BLOCKS_PER_TICK; i++) {
+		int b = index->next_block;
+		index->next_block = (b + 1) % n_blocks;
+		if (index->blocks[b].scanned)
+			index->pending.push_back(b);
+	}
+
+	start_pointer_scan(*index, POINTER_INDEX_BLOCKS_PER_TICK);
+}
+
+static Pointer_Index *open_pointer_index(Source& source) {
+	SOURCE_HANDLE handle = get_readonly_process_handle(source.pid);
+	if (!handle)
+		return nullptr;
+
+	auto index = new Pointer_Index();
+	index->handle = handle;
+	index->pid = source.pid;
+	index->next_block = 0;
+	index->ready = false;
+	index->regions_changed = false;
+	index->thread = nullptr;
+	index->busy = false;
+	index->cancelled = false;
+	for (int i = 0; i < MAX_WORKERS; i++)
+		index->buffers[i] = nullptr;
+
+	layout_pointer_blocks(*index, source);
+
+	// the first pass goes through every block with all the workers there are, which update_pointer_index() picks up whenever it's finished
+	index->pending.resize(index->blocks.size());
+	for (int i = 0; i < index->blocks.size(); i++)
+		index->pending[i] = i;
+
+	start_pointer_scan(*index, get_worker_count());
+	return index;
+}
+
+void close_pointer_index(Source& source) {
+	Pointer_Index *index = source.pointer_index;
+	if (!index)
+		return;
+
+	index->cancelled = true;
+	if (index->thread)
+		join_thread(index->thread);
+
+	for (int i = 0; i < MAX_WORKERS; i++)
+		delete[] index->buffers[i];
+
+	close_readonly_handle(index->handle);
+	delete index;
+
+	source.pointer_index = nullptr;
+}
+
+bool find_pointers_to(Source& source, u64 start, u64 end, std::vector<u64>& addresses, int max, u64& total) {
+	addresses.resize(0);
+	total = 0;
+	if (source.type != SourceProcess || end <= start)
+		return true;
+
+	if (!source.pointer_index)
+		source.pointer_index = open_pointer_index(source);
+	if (!source.pointer_index)
+		return true;
+
+	if (!source.pointer_index->ready)
+		return false;
+
+	for (auto& block : source.pointer_index->blocks) {
+		auto first = std::lower_bound(block.values.begin(), block.values.end(), start);
+		auto last = std::lower_bound(first, block.values.end(), end);
+		total += last - first;
+
+		int n_before = addresses.size();
+		for (auto it = first; it != last && addresses.size() < max; it++)
+			addresses.push_back(block.start + block.offsets[it - block.values.begin()]);
+
+		// the blocks are in address order, but within a block they're in order of where they point
+		std::sort(addresses.begin() + n_before, addresses.end());
+	}
+
+	return true;
+}
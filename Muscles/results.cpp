@@ -0,0 +1,416 @@
+#include "muscles.h"
+#include "structs.h"
+#include "search.h"
+#include "kernels.h"
+
+#include <algorithm>
+
+void Result_Set::clear() {
+	pages.resize(0);
+	pool.resize(0);
+	total = 0;
+}
+
+// Slots can be at most 8 bytes wide, so that a bitmap always fits into a whole number of u64s
+void Result_Set::set_stride(int align) {
+	stride = 1;
+	while (stride < 8 && align > 0 && (align % (stride * 2)) == 0)
+		stride *= 2;
+}
+
+void Result_Set::add_page(u64 address, const u16 *offsets, int count) {
+	if (count <= 0)
+		return;
+
+	if (pages.size() > 0 && pages.back().address == address) {
+		// this can only happen when two halves of the same page were scanned separately
+		u16 merged[PAGE_SIZE * 2];
+		Result_Page last = pages.back();
+		int n = get_offsets(pages.size() - 1, merged);
+		memcpy(&merged[n], offsets, count * sizeof(u16));
+		std::sort(&merged[0], &merged[n + count]);
+		n = std::unique(&merged[0], &merged[n + count]) - &merged[0];
+
+		pages.pop_back();
+		pool.resize(last.data);
+		total = last.index;
+		add_page(address, merged, n);
+		return;
+	}
+
+	const int n_slots = PAGE_SIZE / stride;
+
+	bool aligned = true;
+	for (int i = 0; i < count && aligned; i++)
+		aligned = (offsets[i] % stride) == 0;
+
+	int list_bytes = count * sizeof(u16);
+	int bitmap_bytes = n_slots / 8;
+
+	Result_Page page = {
+		.address = address,
+		.index = total,
+		.data = (u32)pool.size(),
+		.count = (u16)count,
+		.encoding = RESULTS_LIST
+	};
+
+	if (aligned && count == n_slots) {
+		page.encoding = RESULTS_ALL;
+	}
+	else if (aligned && bitmap_bytes < list_bytes) {
+		page.encoding = RESULTS_BITMAP;
+
+		int n_words = bitmap_bytes / sizeof(u64);
+		pool.resize(pool.size() + n_words, 0);
+
+		u64 *bitmap = &pool[page.data];
+		for (int i = 0; i < count; i++) {
+			int slot = offsets[i] / stride;
+			bitmap[slot >> 6] |= 1ULL << (u64)(slot & 63);
+		}
+	}
+	else {
+		int n_words = (list_bytes + sizeof(u64) - 1) / sizeof(u64);
+		pool.resize(pool.size() + n_words, 0);
+		memcpy(&pool[page.data], offsets, list_bytes);
+	}
+
+	pages.push_back(page);
+	total += count;
+}
+
+void Result_Set::append(Result_Set& other) {
+	if (other.total == 0)
+		return;
+
+	bool can_copy = other.stride == stride && (pages.size() == 0 || pages.back().address < other.pages[0].address);
+	if (!can_copy) {
+		u16 offsets[PAGE_SIZE];
+		for (int i = 0; i < other.pages.size(); i++) {
+			int n = other.get_offsets(i, offsets);
+			add_page(other.pages[i].address, offsets, n);
+		}
+		return;
+	}
+
+	u32 pool_base = pool.size();
+	pool.insert(pool.end(), other.pool.begin(), other.pool.end());
+
+	for (auto& p : other.pages) {
+		Result_Page page = p;
+		page.index += total;
+		page.data += pool_base;
+		pages.push_back(page);
+	}
+
+	total += other.total;
+}
+
+int Result_Set::get_offsets(int page_idx, u16 *offsets) const {
+	const Result_Page& page = pages[page_idx];
+	int n = 0;
+
+	if (page.encoding == RESULTS_ALL) {
+		for (int i = 0; i < PAGE_SIZE; i += stride)
+			offsets[n++] = i;
+	}
+	else if (page.encoding == RESULTS_BITMAP) {
+		const u64 *bitmap = &pool[page.data];
+		int n_words = PAGE_SIZE / stride / 64;
+
+		for (int i = 0; i < n_words; i++) {
+			u64 word = bitmap[i];
+			while (word) {
+				int bit = lowest_bit(word);
+				offsets[n++] = (i * 64 + bit) * stride;
+				word &= word - 1;
+			}
+		}
+	}
+	else {
+		n = page.count;
+		memcpy(offsets, &pool[page.data], n * sizeof(u16));
+	}
+
+	return n;
+}
+
+u64 Result_Set::at(u64 idx) const {
+	if (idx >= total)
+		return 0;
+
+	auto it = std::upper_bound(pages.begin(), pages.end(), idx, [](u64 i, const Result_Page& p) {
+		return i < p.index;
+	});
+	int page_idx = (it - pages.begin()) - 1;
+
+	u16 offsets[PAGE_SIZE];
+	get_offsets(page_idx, offsets);
+
+	return pages[page_idx].address + offsets[idx - pages[page_idx].index];
+}
+
+u64 Result_Set::memory_size() const {
+	return pages.size() * sizeof(Result_Page) + pool.size() * sizeof(u64);
+}
+
+struct Result_Set_Header {
+	u64 total;
+	u64 n_pages;
+	u64 n_pool;
+	int stride;
+	u32 reserved;
+};
+
+u64 Result_Set::save(FILE *f) const {
+	Result_Set_Header header = {
+		.total = total,
+		.n_pages = pages.size(),
+		.n_pool = pool.size(),
+		.stride = stride,
+		.reserved = 0
+	};
+
+	if (fwrite(&header, sizeof(header), 1, f) != 1)
+		return 0;
+	if (pages.size() > 0 && fwrite(pages.data(), sizeof(Result_Page), pages.size(), f) != pages.size())
+		return 0;
+	if (pool.size() > 0 && fwrite(pool.data(), sizeof(u64), pool.size(), f) != pool.size())
+		return 0;
+
+	return sizeof(header) + pages.size() * sizeof(Result_Page) + pool.size() * sizeof(u64);
+}
+
+u64 Result_Set::load(const u8 *data, u64 size) {
+	clear();
+
+	Result_Set_Header header;
+	if (size < sizeof(header))
+		return 0;
+
+	memcpy(&header, data, sizeof(header));
+	if (header.n_pages > size / sizeof(Result_Page) || header.n_pool > size / sizeof(u64))
+		return 0;
+
+	u64 used = sizeof(header) + header.n_pages * sizeof(Result_Page) + header.n_pool * sizeof(u64);
+	if (used > size || header.stride < 1 || header.stride > 8)
+		return 0;
+
+	const Result_Page *p = (const Result_Page*)&data[sizeof(header)];
+	const u64 *w = (const u64*)&p[header.n_pages];
+
+	pages.assign(p, p + header.n_pages);
+	pool.assign(w, w + header.n_pool);
+	total = header.total;
+	stride = header.stride;
+
+	// a page whose offsets reach outside the pool or don't fit in a page would be read from later on, and at() relies on each index
+	//  being the sum of the counts before it, so any of those means the file's been damaged.
+	// Everything that goes through the set also expects pages in ascending order, and offsets that are ascending and on the stride.
+	const u64 n_slots = PAGE_SIZE / stride;
+	const u64 bitmap_words = n_slots / 64;
+	u64 index = 0;
+
+	for (int i = 0; i < pages.size(); i++) {
+		const Result_Page& pg = pages[i];
+
+		u64 n_words = 0;
+		if (pg.encoding == RESULTS_LIST)
+			n_words = (pg.count * sizeof(u16) + sizeof(u64) - 1) / sizeof(u64);
+		else if (pg.encoding == RESULTS_BITMAP)
+			n_words = bitmap_words;
+
+		bool ok = pg.encoding <= RESULTS_BITMAP && (u64)pg.data + n_words <= pool.size();
+		ok = ok && pg.count <= n_slots && (pg.encoding != RESULTS_ALL || pg.count == n_slots);
+		ok = ok && pg.index == index;
+		ok = ok && (pg.address & (PAGE_SIZE - 1)) == 0 && (i == 0 || pg.address > pages[i-1].address);
+
+		if (ok && pg.encoding == RESULTS_LIST) {
+			const u16 *offsets = (const u16*)&pool[pg.data];
+			for (int j = 0; j < pg.count && ok; j++) {
+				u16 off = offsets[j];
+				ok = off < PAGE_SIZE && off % stride == 0 && (j == 0 || off > offsets[j-1]);
+			}
+		}
+		else if (ok && pg.encoding == RESULTS_BITMAP) {
+			u64 n_bits = 0;
+			for (u64 j = 0; j < bitmap_words; j++) {
+				for (u64 word = pool[pg.data + j]; word; word &= word - 1)
+					n_bits++;
+			}
+			ok = n_bits == pg.count;
+		}
+
+		if (!ok) {
+			clear();
+			return 0;
+		}
+
+		index += pg.count;
+	}
+
+	if (index != total) {
+		clear();
+		return 0;
+	}
+
+	return used;
+}
+
+#define PAGE_BIT_WORDS (PAGE_SIZE / 64)
+
+// One bit for every byte in the page, whatever the stride, so that pages from sets with different strides can be lined up
+static void get_page_bits(const Result_Set& set, int page_idx, u64 *bits) {
+	memset(bits, 0, PAGE_BIT_WORDS * sizeof(u64));
+
+	u16 offsets[PAGE_SIZE];
+	int n = set.get_offsets(page_idx, offsets);
+	for (int i = 0; i < n; i++)
+		bits[offsets[i] >> 6] |= 1ULL << (u64)(offsets[i] & 63);
+}
+
+static void add_page_bits(Result_Set& out, u64 address, const u64 *bits) {
+	u16 offsets[PAGE_SIZE];
+	int n = 0;
+
+	for (int i = 0; i < PAGE_BIT_WORDS; i++) {
+		u64 word = bits[i];
+		while (word) {
+			offsets[n++] = i * 64 + lowest_bit(word);
+			word &= word - 1;
+		}
+	}
+
+	out.add_page(address, offsets, n);
+}
+
+static void copy_page(Result_Set& out, const Result_Set& set, int page_idx) {
+	u16 offsets[PAGE_SIZE];
+	int n = set.get_offsets(page_idx, offsets);
+	out.add_page(set.pages[page_idx].address, offsets, n);
+}
+
+// Steps through every address in a set, in order
+struct Result_Cursor {
+	const Result_Set& set;
+	int page = -1;
+	int pos = 0;
+	int n = 0;
+	u64 address = 0;
+	u16 offsets[PAGE_SIZE];
+
+	Result_Cursor(const Result_Set& s) : set(s) {}
+
+	bool next() {
+		pos++;
+		while (pos >= n) {
+			page++;
+			if (page >= (int)set.pages.size())
+				return false;
+
+			n = set.get_offsets(page, offsets);
+			pos = 0;
+		}
+
+		address = set.pages[page].address + offsets[pos];
+		return true;
+	}
+};
+
+// The closest address in 'b' that isn't below (x - distance) only ever moves forward as x does, so each set is only walked through once
+static void combine_within(const Result_Set& a, const Result_Set& b, u64 distance, Result_Set& out) {
+	Result_Cursor cursor(b);
+	bool more = cursor.next();
+
+	u16 offsets[PAGE_SIZE];
+	u16 kept[PAGE_SIZE];
+
+	for (int i = 0; i < a.pages.size() && more; i++) {
+		u64 page = a.pages[i].address;
+		int n = a.get_offsets(i, offsets);
+		int n_kept = 0;
+
+		for (int j = 0; j < n; j++) {
+			u64 x = page + offsets[j];
+			u64 lower = x >= distance ? x - distance : 0;
+			u64 upper = x + distance >= x ? x + distance : ~0ULL;
+
+			while (more && cursor.address < lower)
+				more = cursor.next();
+
+			if (more && cursor.address <= upper)
+				kept[n_kept++] = offsets[j];
+		}
+
+		out.add_page(page, kept, n_kept);
+	}
+}
+
+void combine_result_sets(const Result_Set& a, const Result_Set& b, int op, u64 distance, Result_Set& out) {
+	out.clear();
+
+	// strides are powers of two, so an address in both sets lines up with the wider one
+	if (op == COMBINE_INTERSECT)
+		out.set_stride(std::max(a.stride, b.stride));
+	else if (op == COMBINE_UNION)
+		out.set_stride(std::min(a.stride, b.stride));
+	else
+		out.set_stride(a.stride);
+
+	if (op == COMBINE_WITHIN) {
+		combine_within(a, b, distance, out);
+		return;
+	}
+
+	u64 bits_a[PAGE_BIT_WORDS];
+	u64 bits_b[PAGE_BIT_WORDS];
+
+	const int n_a = a.pages.size();
+	const int n_b = b.pages.size();
+	int i = 0, j = 0;
+
+	while (i < n_a || j < n_b) {
+		if (op != COMBINE_UNION && i >= n_a)
+			break;
+		if (op == COMBINE_INTERSECT && j >= n_b)
+			break;
+
+		u64 addr_a = i < n_a ? a.pages[i].address : ~0ULL;
+		u64 addr_b = j < n_b ? b.pages[j].address : ~0ULL;
+
+		if (addr_a < addr_b) {
+			if (op != COMBINE_INTERSECT)
+				copy_page(out, a, i);
+			i++;
+			continue;
+		}
+		if (addr_b < addr_a) {
+			if (op == COMBINE_UNION)
+				copy_page(out, b, j);
+			j++;
+			continue;
+		}
+
+		get_page_bits(a, i, bits_a);
+		get_page_bits(b, j, bits_b);
+
+		// whole words at a time, with no branches, so that these become vector instructions
+		if (op == COMBINE_INTERSECT) {
+			for (int k = 0; k < PAGE_BIT_WORDS; k++)
+				bits_a[k] &= bits_b[k];
+		}
+		else if (op == COMBINE_UNION) {
+			for (int k = 0; k < PAGE_BIT_WORDS; k++)
+				bits_a[k] |= bits_b[k];
+		}
+		else {
+			for (int k = 0; k < PAGE_BIT_WORDS; k++)
+				bits_a[k] &= ~bits_b[k];
+		}
+
+		add_page_bits(out, addr_a, bits_a);
+		i++;
+		j++;
+	}
+}
@@ -1,463 +1,3085 @@
 #include "muscles.h"
 #include "structs.h"
 #include "search.h"
+#include "thread-pool.h"
+#include "kernels.h"
+#include "stream.h"
 
 #include <cstdint>
+#include <cmath>
+#include <limits>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+// First scans are split into chunks between STREAM_MIN_BLOCK and STREAM_MAX_BLOCK in size, which are then shared out between worker threads.
+// Each worker double-buffers its chunks, so this caps how much memory that can take up between them.
+#define SCAN_MEMORY_LIMIT (512 * 1024 * 1024)
+
+// Reading from another process is just a memory copy, so its chunks are kept small enough to still be in cache when they get scanned.
+// Files benefit from bigger reads.
+#define SCAN_PROCESS_MAX_BLOCK (4 * 1024 * 1024)
+
+// First scans go through regions in this many passes, from the most likely to have what's being searched for to the least
+#define SCAN_PRIORITIES 3
+
+// Refinements read this many result pages at a time, wherever they are.
+// Passes over fewer pages split them into smaller tasks, but not smaller than REFINE_MIN_TASK_PAGES.
+#define REFINE_BATCH_PAGES     256
+#define REFINE_MIN_TASK_PAGES  16
+
+// Pointer scans give up on finding any more paths once this many addresses have been looked at
+#define MAX_POINTER_NODES (16 * 1024 * 1024)
+
+// Carries the first MAX_DISPLAYED_RESULTS results of a pass to the UI while the pass is still going.
+// Only one thread ever pushes and only one thread ever pops, so the two counters are all the synchronisation it needs.
+// The ring is big enough to hold every result that a pass streams, so a push never has to wait.
+struct Result_Queue {
+	u64 *ring = nullptr;
+	alignas(64) std::atomic<u64> head = {0}; // next entry to pop, only moved by the consumer
+	alignas(64) std::atomic<u64> tail = {0}; // next entry to push, only moved by the producer
+
+	void reset() {
+		if (!ring)
+			ring = new u64[MAX_DISPLAYED_RESULTS];
+
+		head = 0;
+		tail = 0;
+	}
+
+	bool push(u64 address) {
+		u64 t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) >= MAX_DISPLAYED_RESULTS)
+			return false;
+
+		ring[t % MAX_DISPLAYED_RESULTS] = address;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	int pop(u64 *out, int max) {
+		u64 h = head.load(std::memory_order_relaxed);
+		u64 t = tail.load(std::memory_order_acquire);
+
+		int n = 0;
+		for (; h + n < t && n < max; n++)
+			out[n] = ring[(h + n) % MAX_DISPLAYED_RESULTS];
+
+		head.store(h + n, std::memory_order_release);
+		return n;
+	}
+};
+
+#define SEARCH_FILE_MAGIC    0x5253554d // "MUSR"
+#define SEARCH_RECORD_MAGIC  0x5353414d // "MASS"
+#define SEARCH_FILE_VERSION  1
+
+struct Search_File_Header {
+	u32 magic;
+	u32 version;
+	int source_type;
+	int pid;
+	char source_name[SEARCH_FILE_NAME_LEN];
+	char type_name[SEARCH_FILE_TYPE_LEN];
+	u32 n_passes;
+	u32 reserved;
+	u64 last_record; // where the newest complete record starts, or 0 if there isn't one yet
+};
+
+// Followed by the results, the alternate results and the snapshot, each as saved by their save() method
+struct Search_File_Record {
+	u32 magic;
+	u32 pass;
+	u64 prev; // where the record before this one starts, or 0
+	u64 size; // including this header
+	Search_Parameter param;
+	int byte_align;
+	int reserved;
+	u64 start_addr;
+	u64 end_addr;
+};
+
+// [[module + base_offset] + offsets[0]] + ... + offsets[depth-1]
+struct Pointer_Path {
+	int module; // index into Search_Session::module_names
+	u64 base_offset;
+	u64 base; // where the first pointer was when the path was last checked
+	int depth;
+	int offsets[MAX_POINTER_DEPTH];
+};
+
+struct Pointer_Module {
+	u64 start;
+	u64 end;
+	u64 base; // the start of the lowest region with the same name
+	int name_idx;
+};
+
+// Everything that one search keeps between its passes.
+// Each Search_Menu has its own, so that several searches can run at the same time, each with its own results.
+struct Search_Session {
+	void *thread = nullptr;
+	std::atomic<bool> started = {false};
+	std::atomic<bool> running = {false};
+
+	Result_Set results;
+	Result_Set prev_results;
+
+	// The results that matched the second of two patterns, which are also in 'results'
+	Result_Set alt_results;
+	Result_Set prev_alt_results;
+
+	std::atomic<bool> cancelled = {false};
+	std::atomic<u64> progress_done = {0};
+	std::atomic<u64> progress_total = {0};
+	std::atomic<u64> progress_matches = {0};
+
+	Result_Queue partial_results;
+
+	Snapshot snapshot;
+	Snapshot next_snapshot;
+
+	// Whether the process's soft-dirty bits were cleared just before 'snapshot' was taken, and what clear_generations[pid] was then
+	bool writes_tracked = false;
+	u64 clear_generation = 0;
+
+	// Only written to by the search thread while a search is running, and only by the UI thread otherwise
+	FILE *file = nullptr;
+	Search_File_Header file_header;
+	u64 file_end = 0;
+
+	Search search;
+	std::vector<std::pair<u64, u64>> ranges;
+	std::vector<u8> range_priorities; // one for each range, see get_scan_priority()
+
+	// Pointer scans keep their paths in the same order as 'results', each with a label to show for it.
+	// Module names are only ever added to, so that paths from an earlier pass still refer to the right ones.
+	std::vector<Pointer_Path> paths;
+	std::vector<std::string> path_labels;
+	std::vector<std::string> module_names;
+	std::vector<Pointer_Module> modules; // the modules as they were at the start of this pass, in address order
+
+	// Where to look for glibc's heaps, found from the regions when the search was started, for searches that only look at live allocations
+	std::vector<Heap_Area> heap_areas;
+};
+
+// Only touched from the UI thread, so that exit_search() can close any sessions that are still open
+static std::vector<Search_Session*> sessions;
+
+// How many times each process has had its soft-dirty bits cleared.
+// Another session clearing them would make pages look unwritten to this one, so the count tells sessions when that's happened.
+static std::mutex clear_lock;
+static std::unordered_map<int, u64> clear_generations;
+
+void perform_search(Search_Session& ss);
+
+Search_Session *open_search_session() {
+	auto session = new Search_Session();
+	sessions.push_back(session);
+	return session;
+}
+
+// Waits for the session's search thread, if there is one, to finish
+static void join_search_thread(Search_Session& ss) {
+	if (ss.thread) {
+		join_thread(ss.thread);
+		ss.thread = nullptr;
+	}
+}
+
+void close_search_session(Search_Session *session) {
+	if (!session)
+		return;
+
+	cancel_search(*session);
+	join_search_thread(*session);
+
+	for (int i = 0; i < sessions.size(); i++) {
+		if (sessions[i] == session) {
+			sessions.erase(sessions.begin() + i);
+			break;
+		}
+	}
+
+	detach_search_file(*session);
+
+	delete[] session->partial_results.ring;
+	delete session;
+}
+
+static const char *get_base_name(const char *path) {
+	const char *name = path;
+	for (const char *p = path; *p; p++) {
+		if (*p == '/' || *p == '\\')
+			name = p + 1;
+	}
+	return name;
+}
+
+// Regions that belong to a file (rather than the heap, the stack, or nothing at all) are loaded the same way each time, so a path that starts in one is stable
+static void find_pointer_modules(Search_Session& ss, std::vector<Region> const& regions) {
+	ss.modules.resize(0);
+
+	for (auto& reg : regions) {
+		if (!reg.name || !reg.name[0] || reg.name[0] == '[')
+			continue;
+
+		const char *name = get_base_name(reg.name);
+		int name_idx = -1;
+		for (int i = 0; i < ss.module_names.size() && name_idx < 0; i++) {
+			if (ss.module_names[i] == name)
+				name_idx = i;
+		}
+		if (name_idx < 0) {
+			name_idx = ss.module_names.size();
+			ss.module_names.push_back(name);
+		}
+
+		ss.modules.push_back({
+			.start = reg.base,
+			.end = reg.base + reg.size,
+			.base = reg.base,
+			.name_idx = name_idx
+		});
+	}
+
+	std::sort(ss.modules.begin(), ss.modules.end(), [](const Pointer_Module& a, const Pointer_Module& b) {
+		return a.start < b.start;
+	});
+
+	// the first region of a module is where it was loaded, and every offset is from there
+	for (auto& m : ss.modules) {
+		for (auto& other : ss.modules) {
+			if (other.name_idx == m.name_idx) {
+				m.base = other.start;
+				break;
+			}
+		}
+	}
+}
+
+// Most of what gets searched for is in memory that the process allocated for itself, so that's scanned first.
+// Lower numbers are scanned sooner. Regions that are never worth scanning get -1.
+static int get_scan_priority(const Region& reg) {
+	bool writable = (reg.flags & (1 << REG_PM_WRITE)) != 0;
+
+	switch (reg.type) {
+		case RegionHeap:
+		case RegionAnon:
+			return writable ? 0 : 1;
+		case RegionStack:
+			return 1;
+		case RegionImage:
+			return writable ? 1 : SCAN_PRIORITIES - 1;
+		case RegionSystem:
+		case RegionGuard:
+			return -1;
+		case RegionUnknown:
+			return 1;
+	}
+
+	return 1;
+}
+
+void start_search(Search_Session& ss, Search& s, std::vector<Region> const& regions) {
+	if (ss.running)
+		return;
+
+	std::vector<const Region*> sorted;
+	for (auto& reg : regions) {
+		// a pointer scan maps out every pointer into somewhere that can be read, so only those regions count
+		if (s.max_depth > 0 && (reg.flags & (1 << REG_PM_READ)) == 0)
+			continue;
+		// pointers can go anywhere that can be read, so it's only other searches that leave out the regions that aren't worth scanning
+		if (s.max_depth == 0 && get_scan_priority(reg) < 0)
+			continue;
+
+		sorted.push_back(&reg);
+	}
+
+	std::sort(sorted.begin(), sorted.end(), [](const Region *a, const Region *b) {
+		return a->base < b->base;
+	});
+
+	ss.ranges.resize(0);
+	ss.range_priorities.resize(0);
+	for (auto reg : sorted) {
+		int priority = get_scan_priority(*reg);
+		ss.ranges.push_back(std::make_pair(reg->base, reg->size));
+		ss.range_priorities.push_back(priority < 0 ? SCAN_PRIORITIES - 1 : priority);
+	}
+
+	if (s.max_depth > 0)
+		find_pointer_modules(ss, regions);
+
+	// region names can't be used from the search thread, since they can be rewritten whenever the regions are refreshed
+	ss.heap_areas.resize(0);
+	if (s.live_chunks_only && s.source_type == SourceProcess)
+		find_heap_areas(regions, ss.heap_areas);
+
+	ss.search.params = s.params;
+	if (ss.search.params) {
+		ss.search.n_params = s.n_params;
+		ss.search.record = s.record;
+	}
+	else
+		ss.search.single_value = s.single_value;
+
+	ss.search.n_patterns = s.n_patterns;
+	for (int i = 0; i < s.n_patterns; i++)
+		ss.search.patterns[i] = s.patterns[i];
+
+	ss.search.group = s.group;
+
+	ss.search.byte_align = s.byte_align;
+	ss.search.resident_only = s.resident_only;
+	ss.search.track_writes = s.track_writes;
+	ss.search.live_chunks_only = s.live_chunks_only;
+
+	ss.search.start_addr = s.start_addr;
+	ss.search.end_addr = s.end_addr;
+
+	ss.search.source_type = s.source_type;
+	ss.search.pid = s.pid;
+	ss.search.identifier = s.identifier;
+
+	ss.search.pointer_target = s.pointer_target;
+	ss.search.max_depth = s.max_depth;
+	ss.search.max_offset = s.max_offset;
+
+	ss.cancelled = false;
+	ss.progress_done = 0;
+	ss.progress_total = 0;
+	ss.progress_matches = 0;
+	ss.partial_results.reset();
+
+	// the last search has finished by now, but its thread still has to be cleaned up
+	join_search_thread(ss);
+
+	// set here rather than in the search thread, so that the search counts as running as soon as this returns
+	ss.started = true;
+	ss.running = true;
+
+	auto func = [](void *data) {
+		perform_search(*(Search_Session*)data);
+		return (THREAD_RETURN_TYPE)0;
+	};
+	if (!start_thread(&ss.thread, &ss, func)) {
+		ss.thread = nullptr;
+		ss.running = false;
+	}
+}
+
+bool check_search_running(Search_Session& ss) {
+	return ss.running;
+}
+
+bool check_search_finished(Search_Session& ss) {
+	bool finished = ss.started && !ss.running;
+	if (finished)
+		ss.started = false;
+
+	return finished;
+}
+
+void get_search_results(Search_Session& ss, std::vector<u64>& results_vec) {
+	u64 n = ss.results.total;
+	if (n > MAX_DISPLAYED_RESULTS)
+		n = MAX_DISPLAYED_RESULTS;
+
+	results_vec.resize(n);
+
+	u16 offsets[PAGE_SIZE];
+	u64 idx = 0;
+	for (int i = 0; i < ss.results.pages.size() && idx < n; i++) {
+		int n_offsets = ss.results.get_offsets(i, offsets);
+		u64 page = ss.results.pages[i].address;
+
+		for (int j = 0; j < n_offsets && idx < n; j++)
+			results_vec[idx++] = page + offsets[j];
+	}
+}
+
+// Labels each of the rows that get_search_results() gives with the pattern that found it, or nullptr if it wasn't a pattern search
+void get_search_result_labels(Search_Session& ss, std::vector<char*>& labels) {
+	u64 n = ss.results.total;
+	if (n > MAX_DISPLAYED_RESULTS)
+		n = MAX_DISPLAYED_RESULTS;
+
+	labels.resize(n);
+
+	// a pointer scan's results are where its paths start, so each one is labelled with its path
+	if (ss.paths.size() > 0) {
+		for (u64 i = 0; i < n; i++) {
+			u64 address = ss.results.at(i);
+			auto it = std::lower_bound(ss.paths.begin(), ss.paths.end(), address, [](const Pointer_Path& p, u64 addr) {
+				return p.base < addr;
+			});
+
+			labels[i] = it != ss.paths.end() && it->base == address ? (char*)ss.path_labels[it - ss.paths.begin()].c_str() : nullptr;
+		}
+		return;
+	}
+
+	char *label = ss.search.n_patterns > 0 ? (char*)ss.search.patterns[0].label : nullptr;
+	char *alt_label = ss.search.n_patterns > 1 ? (char*)ss.search.patterns[1].label : nullptr;
+
+	u16 offsets[PAGE_SIZE];
+	u16 alt_offsets[PAGE_SIZE];
+	int alt_page = 0;
+
+	u64 idx = 0;
+	for (int i = 0; i < ss.results.pages.size() && idx < n; i++) {
+		int n_offsets = ss.results.get_offsets(i, offsets);
+		u64 page = ss.results.pages[i].address;
+
+		// both sets are in address order, so the matching page in alt_results is never behind the last one
+		while (alt_page < ss.alt_results.pages.size() && ss.alt_results.pages[alt_page].address < page)
+			alt_page++;
+
+		int n_alt = 0;
+		if (alt_page < ss.alt_results.pages.size() && ss.alt_results.pages[alt_page].address == page)
+			n_alt = ss.alt_results.get_offsets(alt_page, alt_offsets);
+
+		int a = 0;
+		for (int j = 0; j < n_offsets && idx < n; j++) {
+			while (a < n_alt && alt_offsets[a] < offsets[j])
+				a++;
+
+			labels[idx++] = (a < n_alt && alt_offsets[a] == offsets[j]) ? alt_label : label;
+		}
+	}
+}
+
+void get_search_progress(Search_Session& ss, Search_Progress& progress) {
+	progress.done = ss.progress_done;
+	progress.total = ss.progress_total;
+	progress.matches = ss.progress_matches;
+}
+
+int take_partial_results(Search_Session& ss, u64 *out, int max) {
+	if (!ss.partial_results.ring)
+		return 0;
+
+	return ss.partial_results.pop(out, max);
+}
+
+void cancel_search(Search_Session& ss) {
+	if (ss.running)
+		ss.cancelled = true;
+}
+
+u64 get_search_result_count(Search_Session& ss) {
+	return ss.results.total;
+}
+
+void reset_search(Search_Session& ss) {
+	// the search thread is still using the results and the snapshot, so they can only be thrown away once it's done
+	if (ss.running)
+		return;
+
+	// the next search is a different one, so it doesn't belong in the same file
+	detach_search_file(ss);
+
+	ss.writes_tracked = false;
+	ss.results.clear();
+	ss.alt_results.clear();
+	ss.snapshot.clear();
+
+	ss.paths.resize(0);
+	ss.path_labels.resize(0);
+	ss.module_names.resize(0);
+}
+
+bool combine_search_results(Search_Session& ss, Search_Session& other, int op, u64 distance) {
+	if (&ss == &other || ss.running || other.running)
+		return false;
+
+	Result_Set combined;
+	combine_result_sets(ss.results, other.results, op, distance, combined);
+	std::swap(ss.results, combined);
+
+	// the second pattern's results are only labelled with this session's pattern, so the other session's don't carry over
+	Result_Set alt;
+	combine_result_sets(ss.alt_results, ss.results, COMBINE_INTERSECT, 0, alt);
+	std::swap(ss.alt_results, alt);
+
+	// pages that only the other session has looked at need their old contents for a relative refine to carry on from.
+	// Those were taken at a different time though, so which pages have been written to since then isn't known anymore.
+	if (op == COMBINE_UNION) {
+		ss.snapshot.merge(other.snapshot);
+		ss.writes_tracked = false;
+	}
+
+	return true;
+}
+
+void exit_search() {
+	while (sessions.size() > 0)
+		close_search_session(sessions.back());
+}
+
+static bool seek_file(FILE *f, u64 offset) {
+#ifdef _WIN32
+	return _fseeki64(f, (s64)offset, SEEK_SET) == 0;
+#else
+	return fseeko(f, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+// The header is only updated once the record it points to has been written in full
+static bool write_search_file_header(Search_Session& ss) {
+	return seek_file(ss.file, 0) && fwrite(&ss.file_header, sizeof(Search_File_Header), 1, ss.file) == 1 && fflush(ss.file) == 0;
+}
+
+bool attach_search_file(Search_Session& ss, const char *path, SourceType source_type, int pid, const char *source_name, const char *type_name) {
+	if (ss.running)
+		return false;
+
+	detach_search_file(ss);
+
+	ss.file = fopen(path, "w+b");
+	if (!ss.file)
+		return false;
+
+	Search_File_Header& h = ss.file_header;
+	memset(&h, 0, sizeof(h));
+	h.magic = SEARCH_FILE_MAGIC;
+	h.version = SEARCH_FILE_VERSION;
+	h.source_type = (int)source_type;
+	h.pid = pid;
+	strncpy(h.source_name, source_name ? source_name : "", SEARCH_FILE_NAME_LEN - 1);
+	strncpy(h.type_name, type_name ? type_name : "", SEARCH_FILE_TYPE_LEN - 1);
+
+	ss.file_end = sizeof(Search_File_Header);
+
+	if (!write_search_file_header(ss)) {
+		detach_search_file(ss);
+		return false;
+	}
+
+	return true;
+}
+
+void detach_search_file(Search_Session& ss) {
+	if (ss.file) {
+		fclose(ss.file);
+		ss.file = nullptr;
+	}
+}
+
+// Appends the pass that just finished. If that fails, the session stops writing to the file, but the records that were already there are left alone.
+static void write_search_record(Search_Session& ss) {
+	Search_File_Record rec = {
+		.magic = SEARCH_RECORD_MAGIC,
+		.pass = ss.file_header.n_passes + 1,
+		.prev = ss.file_header.last_record,
+		.size = 0,
+		.param = ss.search.single_value,
+		.byte_align = ss.search.byte_align,
+		.reserved = 0,
+		.start_addr = ss.search.start_addr,
+		.end_addr = ss.search.end_addr
+	};
+
+	u64 start = ss.file_end;
+	bool ok = seek_file(ss.file, start) && fwrite(&rec, sizeof(rec), 1, ss.file) == 1;
+
+	u64 sizes[3] = {0};
+	if (ok) sizes[0] = ss.results.save(ss.file);
+	if (ok && sizes[0]) sizes[1] = ss.alt_results.save(ss.file);
+	if (ok && sizes[1]) sizes[2] = ss.snapshot.save(ss.file);
+
+	ok = ok && sizes[0] && sizes[1] && sizes[2];
+	if (ok) {
+		rec.size = sizeof(rec) + sizes[0] + sizes[1] + sizes[2];
+		ok = seek_file(ss.file, start) && fwrite(&rec, sizeof(rec), 1, ss.file) == 1 && fflush(ss.file) == 0;
+	}
+
+	if (ok) {
+		ss.file_header.n_passes++;
+		ss.file_header.last_record = start;
+		ss.file_end = start + rec.size;
+		ok = write_search_file_header(ss);
+	}
+
+	if (!ok) {
+		sdl_log_string("Error: could not write to the search file, so the rest of this search won't be kept in it");
+		detach_search_file(ss);
+	}
+}
+
+// Checks that a record lies inside the file and looks like one
+static const Search_File_Record *get_search_record(const u8 *data, u64 size, u64 offset) {
+	if (offset < sizeof(Search_File_Header) || offset > size || size - offset < sizeof(Search_File_Record) || (offset % sizeof(u64)) != 0)
+		return nullptr;
+
+	auto rec = (const Search_File_Record*)&data[offset];
+	if (rec->magic != SEARCH_RECORD_MAGIC || rec->size < sizeof(Search_File_Record) || rec->size > size - offset)
+		return nullptr;
+
+	return rec;
+}
+
+// Everything is loaded into the caller's temporaries, so that a damaged file leaves the session it was meant for untouched
+static bool load_search_file(const u8 *data, u64 size, Search_File_Info& info, Result_Set& results, Result_Set& alt_results, Snapshot& snapshot, Search_File_Header& header_out, u64& end) {
+	if (size < sizeof(Search_File_Header))
+		return false;
+
+	Search_File_Header header;
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != SEARCH_FILE_MAGIC || header.version != SEARCH_FILE_VERSION || header.n_passes == 0)
+		return false;
+
+	header.source_name[SEARCH_FILE_NAME_LEN - 1] = 0;
+	header.type_name[SEARCH_FILE_TYPE_LEN - 1] = 0;
+
+	const Search_File_Record *last = get_search_record(data, size, header.last_record);
+	if (!last)
+		return false;
+
+	// the records are linked from newest to oldest, and each one has to come before the one that points to it
+	info.history.resize(0);
+	u64 offset = header.last_record;
+	for (u32 i = 0; i < header.n_passes && offset != 0; i++) {
+		const Search_File_Record *rec = get_search_record(data, size, offset);
+		if (!rec)
+			return false;
+
+		info.history.push_back(rec->param);
+		if (rec->prev >= offset)
+			break;
+
+		offset = rec->prev;
+	}
+
+	if (info.history.size() == 0)
+		return false;
+
+	std::reverse(info.history.begin(), info.history.end());
+
+	const u8 *body = (const u8*)&last[1];
+	u64 left = last->size - sizeof(Search_File_Record);
+
+	u64 used = results.load(body, left);
+	if (!used)
+		return false;
+
+	body += used;
+	left -= used;
+	used = alt_results.load(body, left);
+	if (!used)
+		return false;
+
+	body += used;
+	left -= used;
+	if (!snapshot.load(body, left))
+		return false;
+
+	info.source_type = (SourceType)header.source_type;
+	info.pid = header.pid;
+	memcpy(info.source_name, header.source_name, SEARCH_FILE_NAME_LEN);
+	memcpy(info.type_name, header.type_name, SEARCH_FILE_TYPE_LEN);
+	info.byte_align = last->byte_align;
+	info.start_addr = last->start_addr;
+	info.end_addr = last->end_addr;
+
+	header_out = header;
+	end = header.last_record + last->size;
+	return true;
+}
+
+bool resume_search_file(Search_Session& ss, const char *path, Search_File_Info& info) {
+	if (ss.running)
+		return false;
+
+	SOURCE_HANDLE handle = get_readonly_file_handle((void*)path);
+	if (!handle)
+		return false;
+
+	u64 size = get_file_size(handle);
+	const u8 *data = (const u8*)map_file_view(handle, 0, size);
+
+	Search_File_Info loaded;
+	Result_Set results;
+	Result_Set alt_results;
+	Snapshot snapshot;
+	Search_File_Header header;
+
+	u64 end = 0;
+	bool ok = data && load_search_file(data, size, loaded, results, alt_results, snapshot, header, end);
+
+	unmap_file_view((void*)data, size);
+	close_readonly_handle(handle);
+
+	if (!ok)
+		return false;
+
+	// the current results only get thrown away once there's something good to replace them with
+	reset_search(ss);
+	std::swap(ss.results, results);
+	std::swap(ss.alt_results, alt_results);
+	ss.snapshot.swap(snapshot);
+	ss.file_header = header;
+	info = loaded;
+
+	// anything past the latest record is from a pass that never finished, so it just gets written over
+	ss.file = fopen(path, "r+b");
+	ss.file_end = end;
+	if (!ss.file)
+		sdl_log_string("Error: the search file can't be written to, so passes from here on won't be kept in it");
+
+	ss.search.single_value = info.history.back();
+	ss.search.byte_align = info.byte_align;
+	ss.search.start_addr = info.start_addr;
+	ss.search.end_addr = info.end_addr;
+	ss.search.source_type = info.source_type;
+	ss.search.pid = info.pid;
+	return true;
+}
+
+SOURCE_HANDLE open_search_handle(Search_Session& ss) {
+	auto handle = (SOURCE_HANDLE)0;
+	if (ss.search.source_type == SourceFile)
+		handle = get_readonly_file_handle(ss.search.identifier);
+	else if (ss.search.source_type == SourceProcess)
+		handle = get_readonly_process_handle(ss.search.pid);
+
+	return handle;
+}
+
+// Hands each task's results to the partial results queue in task order, so that they come out in the order they were scanned in.
+// Whichever worker finishes the task that's next in line publishes it, along with any tasks after it that are already done.
+// 'busy' makes sure only one worker publishes at a time, which keeps the queue single-producer.
+struct Ordered_Publisher {
+	Search_Session *session = nullptr;
+	std::vector<const Result_Set*> sets;
+	std::atomic<bool> *done = nullptr;
+	std::atomic<bool> busy = {false};
+	int next = 0; // only used by the worker that holds 'busy'
+	u64 n_published = 0;
+
+	~Ordered_Publisher() {
+		delete[] done;
+	}
+
+	void begin() {
+		done = new std::atomic<bool>[sets.size()];
+		for (int i = 0; i < sets.size(); i++)
+			done[i] = false;
+	}
+
+	void publish(const Result_Set& set) {
+		u16 offsets[PAGE_SIZE];
+		for (int i = 0; i < set.pages.size() && n_published < MAX_DISPLAYED_RESULTS; i++) {
+			int n = set.get_offsets(i, offsets);
+			for (int j = 0; j < n && n_published < MAX_DISPLAYED_RESULTS; j++) {
+				session->partial_results.push(set.pages[i].address + offsets[j]);
+				n_published++;
+			}
+		}
+	}
+
+	void finish(int task) {
+		session->progress_matches += sets[task]->total;
+		done[task] = true;
+
+		while (n_published < MAX_DISPLAYED_RESULTS && !session->cancelled) {
+			bool expected = false;
+			if (!busy.compare_exchange_strong(expected, true))
+				return;
+
+			while (next < sets.size() && done[next])
+				publish(*sets[next++]);
+
+			int n = next;
+			busy = false;
+
+			// a task might have finished after it was checked, but before 'busy' was let go of
+			if (n >= sets.size() || !done[n])
+				return;
+		}
+	}
+};
+
+struct Scan_Range {
+	u64 start;
+	int first_range;
+	int last_range;
+};
+
+Scan_Range isolate_scan_ranges(Search_Session& ss) {
+	Scan_Range scan = {
+		.start = ss.search.start_addr,
+		.first_range = -1,
+		.last_range = -1
+	};
+
+	for (auto& r : ss.ranges) {
+		scan.first_range++;
+		if (scan.start < r.first + r.second) {
+			if (scan.start < r.first)
+				scan.start = r.first;
+			break;
+		}
+	}
+	for (auto& r : ss.ranges) {
+		if (ss.search.end_addr < r.first)
+			break;
+
+		scan.last_range++;
+	}
+
+	return scan;
+}
+
+struct Scan_Chunk {
+	u64 origin; // where scanning began inside the range that this chunk belongs to
+	u64 start;
+	u64 end;
+	int priority;
+	int next; // the chunk that gets scanned after this one, or -1
+	Result_Set results;
+	Result_Set alt_results;
+	std::vector<Snapshot_Page> snap_pages;
+};
+
+struct Scan_Worker {
+	SOURCE_HANDLE handle;
+	Read_Stream stream;
+	u32 *hits;
+};
+
+// State shared between the workers of a parallel first scan.
+// Each chunk collects its own results, which are merged in address order once every chunk has been scanned.
+struct Parallel_Scan {
+	Search_Session *session;
+	std::vector<Scan_Chunk> chunks;
+	Scan_Worker workers[MAX_WORKERS];
+	int n_workers;
+
+	int chunk_size;
+	int overlap; // how far past the end of a chunk a value that starts inside it can reach
+
+	void (*scan_func)(void*, int, int);
+	Ordered_Publisher publisher;
+
+	// The chunks are kept in address order, but they're scanned (and published) in order of priority.
+	// Each priority gets its own run of tasks, so that every worker is busy with the most likely chunks first.
+	std::vector<int> order;
+	int first_task; // where the priority being scanned starts in 'order'
+
+	void *extra;
+
+	bool begin_chunk(int worker, int idx);
+	const Stream_Block& read_chunk(int worker, int idx);
+};
+
+// Bigger chunks mean fewer reads, but there should still be a few chunks per worker so that stealing can even out the load
+int pick_chunk_size(int source_type, u64 total_size, int n_workers) {
+	u64 size = source_type == SourceProcess ? SCAN_PROCESS_MAX_BLOCK : STREAM_MAX_BLOCK;
+	while (size > STREAM_MIN_BLOCK && (size * 2 * n_workers > SCAN_MEMORY_LIMIT || size * 4 * n_workers > total_size))
+		size /= 2;
+
+	return (int)size;
+}
+
+void make_scan_chunks(Parallel_Scan& scan) {
+	Search_Session& ss = *scan.session;
+	scan.chunks.resize(0);
+	auto range_span = isolate_scan_ranges(ss);
+
+	u64 total_size = 0;
+	u64 addr = range_span.start;
+	for (int i = range_span.first_range; i <= range_span.last_range && addr <= ss.search.end_addr; i++) {
+		u64 range_end = ss.ranges[i].first + ss.ranges[i].second;
+		if (ss.search.end_addr < range_end)
+			range_end = ss.search.end_addr;
+
+		if (addr < range_end)
+			total_size += range_end - addr;
+
+		if (i < range_span.last_range)
+			addr = ss.ranges[i + 1].first;
+	}
+
+	scan.chunk_size = pick_chunk_size(ss.search.source_type, total_size, scan.n_workers);
+
+	addr = range_span.start;
+	for (int i = range_span.first_range; i <= range_span.last_range && addr <= ss.search.end_addr; i++) {
+		u64 range_end = ss.ranges[i].first + ss.ranges[i].second;
+		if (ss.search.end_addr < range_end)
+			range_end = ss.search.end_addr;
+
+		// ranges without a priority (eg. live heap allocations) are as likely as it gets
+		int priority = i < ss.range_priorities.size() ? ss.range_priorities[i] : 0;
+
+		u64 origin = addr;
+		while (addr < range_end) {
+			// the check for next <= addr is for ranges right at the top of the address space (eg. [vsyscall])
+			u64 next = (addr & ~(u64)(scan.chunk_size - 1)) + scan.chunk_size;
+			if (next > range_end || next <= addr)
+				next = range_end;
+
+			scan.chunks.push_back({
+				.origin = origin,
+				.start = addr,
+				.end = next,
+				.priority = priority,
+				.next = -1
+			});
+			addr = next;
+		}
+
+		if (i < range_span.last_range)
+			addr = ss.ranges[i + 1].first;
+	}
+}
+
+bool Parallel_Scan::begin_chunk(int worker, int idx) {
+	Search_Session& ss = *session;
+	chunks[idx].results.set_stride(ss.results.stride);
+	chunks[idx].alt_results.set_stride(ss.results.stride);
+
+	Scan_Worker& w = workers[worker];
+	if (!w.handle) {
+		w.handle = open_search_handle(ss);
+		if (!w.handle)
+			return false;
+
+		// one extra page, since a chunk that starts partway through a page also has to read the start of that page
+		int capacity = chunk_size + ((overlap + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1)) + PAGE_SIZE;
+		SOURCE_HANDLE page_map = (SOURCE_HANDLE)0;
+		if (ss.search.resident_only && ss.search.source_type == SourceProcess)
+			page_map = get_page_map_handle(ss.search.pid);
+
+		w.stream.open(w.handle, ss.search.source_type, ss.search.pid, capacity, page_map);
+	}
+
+	return true;
+}
+
+// The pages covering a chunk, plus enough pages past its end to cover 'overlap'
+void get_chunk_block(const Scan_Chunk& chunk, int overlap, u64& address, int& size) {
+	address = chunk.start & ~(PAGE_SIZE - 1);
+	u64 end = (chunk.end + overlap + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+	size = (int)(end - address);
+}
+
+// Gets a chunk's pages from this worker's stream, and then starts reading the chunk that's scanned after it,
+//  since workers mostly work through consecutive tasks
+const Stream_Block& Parallel_Scan::read_chunk(int worker, int idx) {
+	Read_Stream& stream = workers[worker].stream;
+
+	u64 address;
+	int size;
+	get_chunk_block(chunks[idx], overlap, address, size);
+	const Stream_Block& block = stream.get(address, size);
+
+	int next = chunks[idx].next;
+	if (next >= 0) {
+		get_chunk_block(chunks[next], overlap, address, size);
+		stream.prefetch(address, size);
+	}
+
+	return block;
+}
+
+void scan_chunk_task(void *data, int worker, int idx) {
+	auto scan = (Parallel_Scan*)data;
+	Search_Session& ss = *scan->session;
+
+	int task = scan->first_task + idx;
+	int chunk_idx = scan->order[task];
+	Scan_Chunk& chunk = scan->chunks[chunk_idx];
+
+	if (!ss.cancelled)
+		scan->scan_func(data, worker, chunk_idx);
+
+	ss.progress_done += chunk.end - chunk.start;
+	scan->publisher.finish(task);
+}
+
+void run_parallel_scan(Search_Session& ss, Parallel_Scan& scan, void (*func)(void*, int, int), int n_hits = 0, int overlap = 0) {
+	scan.session = &ss;
+	scan.publisher.session = &ss;
+	scan.n_workers = get_worker_count();
+	scan.overlap = overlap;
+	scan.scan_func = func;
+	make_scan_chunks(scan);
+
+	int n_chunks = scan.chunks.size();
+
+	int n_tasks[SCAN_PRIORITIES] = {0};
+	scan.order.resize(0);
+	for (int p = 0; p < SCAN_PRIORITIES; p++) {
+		for (int i = 0; i < n_chunks; i++) {
+			if (scan.chunks[i].priority != p)
+				continue;
+
+			if (n_tasks[p] > 0)
+				scan.chunks[scan.order.back()].next = i;
+
+			scan.order.push_back(i);
+			n_tasks[p]++;
+		}
+	}
+
+	u64 total = 0;
+	for (int idx : scan.order) {
+		Scan_Chunk& c = scan.chunks[idx];
+		total += c.end - c.start;
+		scan.publisher.sets.push_back(&c.results);
+	}
+	ss.progress_total = total;
+	scan.publisher.begin();
+
+	for (int i = 0; i < scan.n_workers; i++) {
+		scan.workers[i].handle = (SOURCE_HANDLE)0;
+		scan.workers[i].hits = n_hits > 0 ? new u32[n_hits] : nullptr;
+	}
+
+	scan.first_task = 0;
+	for (int p = 0; p < SCAN_PRIORITIES && !ss.cancelled; p++) {
+		run_tasks(&scan, scan_chunk_task, n_tasks[p], scan.n_workers);
+		scan.first_task += n_tasks[p];
+	}
+
+	for (int i = 0; i < scan.n_workers; i++) {
+		scan.workers[i].stream.close();
+		delete[] scan.workers[i].hits;
+		if (scan.workers[i].handle)
+			close_readonly_handle(scan.workers[i].handle);
+	}
+
+	// a first scan that didn't cover everything can't be refined, so it leaves nothing behind
+	if (ss.cancelled) {
+		ss.results.clear();
+		ss.alt_results.clear();
+		ss.snapshot.clear();
+		return;
+	}
+
+	ss.results.clear();
+	ss.alt_results.clear();
+	ss.alt_results.stride = ss.results.stride;
+
+	for (auto& c : scan.chunks) {
+		ss.results.append(c.results);
+		ss.alt_results.append(c.alt_results);
+		c.results = Result_Set();
+		c.alt_results = Result_Set();
+
+		// two chunks can only share a page if a range ends partway through it, in which case both copies are the same
+		for (auto& p : c.snap_pages) {
+			if (ss.snapshot.pages.size() == 0 || ss.snapshot.pages.back().address < p.address)
+				ss.snapshot.pages.push_back(p);
+		}
+	}
+}
+
+// The share of a refinement pass that one task produces. Tasks are merged in order once they have all finished.
+struct Refine_Task {
+	Result_Set results;
+	Result_Set alt_results;
+	std::vector<Snapshot_Page> snap_pages; // stored in next_snapshot
+	int cursor; // where the last snapshot lookup found its page, since each task's pages are in ascending order
+};
+
+template <typename F>
+struct Parallel_Refine {
+	Search_Session *session;
+	F *func;
+	int window;
+	int batch; // pages per task
+	const u8 *written; // if set, the pages where this is 0 aren't read
+
+	std::vector<Refine_Task> tasks;
+	Ordered_Publisher publisher;
+
+	SOURCE_HANDLE handles[MAX_WORKERS];
+	char *bufs[MAX_WORKERS];
+	Span *spans[MAX_WORKERS];
+};
+
+template <typename F>
+void read_refine_task(Parallel_Refine<F> *refine, int worker, int idx) {
+	Search_Session& ss = *refine->session;
+	Refine_Task& task = refine->tasks[idx];
+
+	if (!refine->handles[worker])
+		refine->handles[worker] = open_search_handle(ss);
+
+	// a worker that couldn't get its own handle (eg. out of fds) shares the first one, which is safe to read from on several threads at once
+	SOURCE_HANDLE handle = refine->handles[worker] ? refine->handles[worker] : refine->handles[0];
+
+	int window = refine->window;
+	if (!refine->bufs[worker]) {
+		refine->bufs[worker] = new char[refine->batch * window];
+		refine->spans[worker] = new Span[refine->batch];
+	}
+
+	char *buf = refine->bufs[worker];
+	Span *spans = refine->spans[worker];
+
+	int first = idx * refine->batch;
+	int batch = ss.prev_results.pages.size() - first;
+	if (batch > refine->batch)
+		batch = refine->batch;
+
+	int n_spans = 0;
+	for (int j = 0; j < batch; j++) {
+		if (refine->written && !refine->written[first + j])
+			continue;
+
+		Span& s = spans[n_spans++];
+		s.data = (u8*)&buf[j * window];
+		s.address = ss.prev_results.pages[first + j].address;
+		s.size = window;
+		s.retrieved = 0;
+		s.tag = first + j;
+	}
+
+	read_spans(handle, ss.search.source_type, ss.search.pid, spans, n_spans);
+
+	// pages that haven't been written to are still in order with the rest, they just don't have a buffer
+	int k = 0;
+	for (int j = 0; j < batch; j++) {
+		if (k < n_spans && spans[k].tag == first + j) {
+			if (spans[k].retrieved > 0)
+				(*refine->func)(first + j, (char*)spans[k].data, spans[k].retrieved, task);
+			k++;
+		}
+		else
+			(*refine->func)(first + j, nullptr, window, task);
+	}
+}
+
+template <typename F>
+void refine_task(void *data, int worker, int idx) {
+	auto refine = (Parallel_Refine<F>*)data;
+	Search_Session& ss = *refine->session;
+	Refine_Task& task = refine->tasks[idx];
+
+	task.results.stride = ss.results.stride;
+	task.alt_results.stride = ss.results.stride;
+	task.cursor = 0;
+
+	if (!ss.cancelled)
+		read_refine_task(refine, worker, idx);
+
+	int n_pages = std::min(refine->batch, (int)ss.prev_results.pages.size() - idx * refine->batch);
+	ss.progress_done += (u64)n_pages * refine->window;
+	refine->publisher.finish(idx);
+}
+
+// Reads each page in prev_results, plus however much comes after it to make up 'window' bytes,
+//  then calls func(page_idx, buf, retrieved, task) for each one that could be at least partly read.
+// If 'written' is given, pages where it's 0 aren't read at all, and func gets nullptr for 'buf' instead.
+// The pages are split into tasks of up to REFINE_BATCH_PAGES pages that are shared between the workers, each of which reads a whole task at once.
+// func is called from several threads at a time, so it should only add to the results and snapshot pages in 'task'.
+// Once every task is done, their results are appended to 'results' and 'alt_results', and their snapshot pages to next_snapshot.
+// If the pass gets cancelled, the results from before it are put back and this returns false.
+template <typename F>
+bool read_result_pages(Search_Session& ss, SOURCE_HANDLE handle, int window, F func, const u8 *written = nullptr) {
+	int n_pages = ss.prev_results.pages.size();
+	if (n_pages == 0)
+		return true;
+
+	Parallel_Refine<F> refine;
+	refine.session = &ss;
+	refine.publisher.session = &ss;
+	refine.func = &func;
+	refine.window = window;
+	refine.written = written;
+
+	int n_workers = get_worker_count();
+
+	// smaller tasks for smaller passes, so that every worker still gets a few of them
+	refine.batch = REFINE_BATCH_PAGES * PAGE_SIZE / window;
+	while (refine.batch > REFINE_MIN_TASK_PAGES && (n_pages + refine.batch - 1) / refine.batch < 4 * n_workers)
+		refine.batch /= 2;
+	if (refine.batch < 1)
+		refine.batch = 1;
+
+	int n_tasks = (n_pages + refine.batch - 1) / refine.batch;
+	if (n_workers > n_tasks)
+		n_workers = n_tasks;
+
+	refine.tasks.resize(n_tasks);
+	for (auto& t : refine.tasks)
+		refine.publisher.sets.push_back(&t.results);
+
+	ss.progress_total = (u64)n_pages * window;
+	refine.publisher.begin();
+
+	for (int i = 0; i < n_workers; i++) {
+		refine.handles[i] = i == 0 ? handle : (SOURCE_HANDLE)0;
+		refine.bufs[i] = nullptr;
+		refine.spans[i] = nullptr;
+	}
+
+	run_tasks(&refine, refine_task<F>, n_tasks, n_workers);
+
+	for (int i = 0; i < n_workers; i++) {
+		delete[] refine.bufs[i];
+		delete[] refine.spans[i];
+		if (i > 0 && refine.handles[i])
+			close_readonly_handle(refine.handles[i]);
+	}
+
+	if (ss.cancelled) {
+		std::swap(ss.results, ss.prev_results);
+		std::swap(ss.alt_results, ss.prev_alt_results);
+		return false;
+	}
+
+	for (auto& t : refine.tasks) {
+		ss.results.append(t.results);
+		ss.alt_results.append(t.alt_results);
+		ss.next_snapshot.pages.insert(ss.next_snapshot.pages.end(), t.snap_pages.begin(), t.snap_pages.end());
+	}
+
+	return true;
+}
+
+template <int method, typename T>
+void single_value_scan_chunk(void *data, int worker, int idx) {
+	auto scan = (Parallel_Scan*)data;
+	if (!scan->begin_chunk(worker, idx))
+		return;
+
+	Search_Session& ss = *scan->session;
+
+	T v1 = ((T*)scan->extra)[0];
+	T v2 = ((T*)scan->extra)[1];
+
+	int byte_align = ss.search.byte_align;
+	if (byte_align <= 0)
+		byte_align = sizeof(T);
+
+	Scan_Chunk& chunk = scan->chunks[idx];
+	const Stream_Block& block = scan->read_chunk(worker, idx);
+	u32 *hits = scan->workers[worker].hits;
+	u16 offsets[PAGE_SIZE];
+
+	int n_pages = (int)((chunk.end - block.address + PAGE_SIZE - 1) / PAGE_SIZE);
+	int offset = (int)(chunk.start - block.address) & ~(sizeof(T) - 1);
+
+	for (int i = 0; i < n_pages; i++, offset = 0) {
+		if (block.pages[i].retrieved <= 0)
+			continue;
+
+		u64 page = block.pages[i].address;
+		char *buf = (char*)block.pages[i].data;
+
+		int limit = PAGE_SIZE;
+		if (chunk.end - page < PAGE_SIZE)
+			limit = (int)(chunk.end - page);
+
+		int n_offsets = 0;
+
+		// When every value is aligned to its own size, the whole page can be compared with SIMD
+		if (byte_align == sizeof(T)) {
+			int end = limit + sizeof(T) - 1;
+			if (end > PAGE_SIZE)
+				end = PAGE_SIZE;
+
+			int n_hits = scan_block<method, T>((u8*)&buf[offset], end - offset, v1, v2, hits);
+			for (int j = 0; j < n_hits; j++)
+				offsets[n_offsets++] = offset + hits[j];
+		}
+		else {
+			for (int j = offset; j <= PAGE_SIZE - sizeof(T) && j < limit; j += byte_align) {
+				T value = *(T*)(&buf[j]);
+				if constexpr (method == METHOD_EQUALS) {
+					if (value == v1)
+						offsets[n_offsets++] = j;
+				}
+				else {
+					if (value >= v1 && value <= v2)
+						offsets[n_offsets++] = j;
+				}
+			}
+		}
+
+		chunk.results.add_page(page, offsets, n_offsets);
+	}
+}
+
+// Clears the soft-dirty bits, so that the next pass can tell which pages have been written to since this one's snapshot.
+// clear_lock must be held.
+static void restart_write_tracking(Search_Session& ss) {
+	ss.writes_tracked = false;
+	if (!ss.search.track_writes || ss.search.source_type != SourceProcess)
+		return;
+
+	if (clear_soft_dirty(ss.search.pid)) {
+		ss.clear_generation = ++clear_generations[ss.search.pid];
+		ss.writes_tracked = true;
+	}
+}
+
+// Called by each pass that takes a snapshot without comparing against the last one, before it reads anything
+void begin_write_tracking(Search_Session& ss) {
+	std::lock_guard<std::mutex> guard(clear_lock);
+	restart_write_tracking(ss);
+}
+
+// Fills 'written' with whether each page in prev_results has been written to since the snapshot was taken, then starts tracking writes again.
+// Returns false if which pages were written to can't be known, in which case every page has to be read.
+// Both happen under clear_lock, so that no other session on the same process can clear the bits in between and hide its writes from this one.
+// A write that lands after the page table is read but before the bits are cleared still can't be seen though, not without stopping the process.
+bool take_written_pages(Search_Session& ss, std::vector<u8>& written) {
+	std::lock_guard<std::mutex> guard(clear_lock);
+
+	bool ok = ss.writes_tracked && clear_generations[ss.search.pid] == ss.clear_generation;
+	if (ok) {
+		SOURCE_HANDLE page_map = get_page_map_handle(ss.search.pid);
+		ok = page_map != (SOURCE_HANDLE)0;
+
+		if (ok) {
+			int n_pages = ss.prev_results.pages.size();
+			std::vector<u64> addresses(n_pages);
+			for (int i = 0; i < n_pages; i++)
+				addresses[i] = ss.prev_results.pages[i].address;
+
+			written.resize(n_pages);
+			ok = read_soft_dirty(page_map, addresses.data(), n_pages, written.data());
+			close_readonly_handle(page_map);
+		}
+	}
+
+	restart_write_tracking(ss);
+	return ok;
+}
+
+// Moves the current results into prev_results, so that a refinement pass can fill 'results' from them
+void begin_refinement(Search_Session& ss) {
+	std::swap(ss.results, ss.prev_results);
+	ss.results.clear();
+	ss.results.stride = ss.prev_results.stride;
+
+	std::swap(ss.alt_results, ss.prev_alt_results);
+	ss.alt_results.clear();
+	ss.alt_results.stride = ss.results.stride;
+}
+
+template <int method, typename T>
+void single_value_search(Search_Session& ss, SOURCE_HANDLE handle, T v1, T v2) {
+	if (ss.results.total == 0) {
+		int byte_align = ss.search.byte_align;
+		if (byte_align <= 0)
+			byte_align = sizeof(T);
+
+		ss.results.set_stride(byte_align);
+
+		T values[] = {v1, v2};
+
+		ss.snapshot.clear();
+
+		Parallel_Scan scan;
+		scan.extra = (void*)values;
+		run_parallel_scan(ss, scan, single_value_scan_chunk<method, T>, PAGE_SIZE / sizeof(T));
+		return;
+	}
+
+	begin_refinement(ss);
+
+	// if this search started with an unknown value, later passes may still want to know what changed since this one
+	bool keep_snapshot = ss.snapshot.pages.size() > 0;
+	ss.next_snapshot.clear();
+	if (keep_snapshot)
+		begin_write_tracking(ss);
+
+	bool finished = read_result_pages(ss, handle, PAGE_SIZE, [&](int i, char *page_buf, int retrieved, Refine_Task& task) {
+		u64 page = ss.prev_results.pages[i].address;
+		u16 offsets[PAGE_SIZE];
+		int n_prev = ss.prev_results.get_offsets(i, offsets);
+		int n_offsets = 0;
+
+		// When every result is aligned to the size of the value, the span covering them can be scanned all at once
+		if (ss.results.stride == sizeof(T)) {
+			u32 hits[PAGE_SIZE / sizeof(T)];
+			int start = offsets[0];
+			int end = offsets[n_prev - 1] + sizeof(T);
+			int n_hits = scan_block<method, T>((u8*)&page_buf[start], end - start, v1, v2, hits);
+
+			// if every slot in the span was a result, then every hit is one too
+			if (n_prev == (end - start) / sizeof(T)) {
+				for (int j = 0; j < n_hits; j++)
+					offsets[n_offsets++] = start + hits[j];
+			}
+			else {
+				int k = 0;
+				for (int j = 0; j < n_hits; j++) {
+					int offset = start + hits[j];
+					while (k < n_prev && offsets[k] < offset)
+						k++;
+					if (k < n_prev && offsets[k] == offset)
+						offsets[n_offsets++] = offset;
+				}
+			}
+		}
+		else {
+			for (int j = 0; j < n_prev; j++) {
+				int offset = offsets[j];
+				if (offset > PAGE_SIZE - sizeof(T))
+					continue;
+
+				T value = *(T*)(&page_buf[offset]);
+				if constexpr (method == METHOD_EQUALS) {
+					if (value == v1)
+						offsets[n_offsets++] = offset;
+				}
+				else {
+					if (value >= v1 && value <= v2)
+						offsets[n_offsets++] = offset;
+				}
+			}
+		}
+
+		task.results.add_page(page, offsets, n_offsets);
+		if (keep_snapshot && n_offsets > 0)
+			task.snap_pages.push_back({page, ss.next_snapshot.store((u8*)page_buf)});
+	});
+
+	if (finished)
+		ss.snapshot.swap(ss.next_snapshot);
+	ss.next_snapshot.clear();
+}
+
+// An unknown value scan doesn't filter anything, it just takes a snapshot of every page and counts every slot as a result
+template <typename T>
+void unknown_scan_chunk(void *data, int worker, int idx) {
+	auto scan = (Parallel_Scan*)data;
+	if (!scan->begin_chunk(worker, idx))
+		return;
+
+	Search_Session& ss = *scan->session;
+
+	int byte_align = ss.search.byte_align;
+	if (byte_align <= 0)
+		byte_align = sizeof(T);
+
+	Scan_Chunk& chunk = scan->chunks[idx];
+	const Stream_Block& block = scan->read_chunk(worker, idx);
+	u16 offsets[PAGE_SIZE];
+
+	int n_pages = (int)((chunk.end - block.address + PAGE_SIZE - 1) / PAGE_SIZE);
+	int offset = (int)(chunk.start - block.address) & ~(sizeof(T) - 1);
+
+	for (int i = 0; i < n_pages; i++, offset = 0) {
+		if (block.pages[i].retrieved <= 0)
+			continue;
+
+		u64 page = block.pages[i].address;
+		int limit = PAGE_SIZE;
+		if (chunk.end - page < PAGE_SIZE)
+			limit = (int)(chunk.end - page);
+
+		int n_offsets = 0;
+		for (int j = offset; j <= PAGE_SIZE - sizeof(T) && j < limit; j += byte_align)
+			offsets[n_offsets++] = j;
+
+		chunk.results.add_page(page, offsets, n_offsets);
+		chunk.snap_pages.push_back({page, ss.snapshot.store(block.pages[i].data)});
+	}
+}
+
+// Takes a snapshot of the pages that hold the current results, without changing the results
+void capture_snapshot(Search_Session& ss, SOURCE_HANDLE handle) {
+	begin_refinement(ss);
+	ss.results.append(ss.prev_results);
+	ss.next_snapshot.clear();
+	begin_write_tracking(ss);
+
+	bool finished = read_result_pages(ss, handle, PAGE_SIZE, [&](int i, char *page_buf, int retrieved, Refine_Task& task) {
+		task.snap_pages.push_back({ss.prev_results.pages[i].address, ss.next_snapshot.store((u8*)page_buf)});
+	});
+
+	if (finished)
+		ss.snapshot.swap(ss.next_snapshot);
+	ss.next_snapshot.clear();
+}
+
+template <int method, typename T>
+void relative_search(Search_Session& ss, SOURCE_HANDLE handle, T delta) {
+	begin_refinement(ss);
+	ss.next_snapshot.clear();
+
+	// Pages that haven't been written to since the last snapshot are the same as their copy in it, so they don't need to be read.
+	// They keep their old blocks, so the new snapshot is built on top of the old one instead of from scratch.
+	// Blocks that stop being used stay around until the snapshot is cleared, but that's only ever as many pages as got written to.
+	std::vector<u8> written;
+	bool skip_clean = take_written_pages(ss, written);
+
+	Snapshot& store_into = skip_clean ? ss.snapshot : ss.next_snapshot;
+	if (skip_clean) {
+		u32 n_written = 0;
+		for (u8 w : written)
+			n_written += w;
+
+		ss.snapshot.reserve(n_written);
+	}
+
+	bool finished = read_result_pages(ss, handle, PAGE_SIZE, [&](int i, char *page_buf, int retrieved, Refine_Task& task) {
+		u64 page = ss.prev_results.pages[i].address;
+
+		int snap_idx = ss.snapshot.find(page, task.cursor);
+		if (snap_idx < 0)
+			return;
+
+		task.cursor = snap_idx;
+		u32 old_block = ss.snapshot.pages[snap_idx].block;
+		const u8 *old = ss.snapshot.get_block(old_block);
+
+		u16 offsets[PAGE_SIZE];
+		int n_prev = ss.prev_results.get_offsets(i, offsets);
+		int n_offsets = 0;
+
+		// An unwritten page has the same values as its snapshot, so every result in it is unchanged, and none of them changed,
+		//  increased or decreased. Only 'changed by' still depends on the values.
+		bool clean = page_buf == nullptr;
+		if (clean && method != METHOD_CHANGED_BY) {
+			if (method == METHOD_UNCHANGED)
+				n_offsets = n_prev;
+
+			task.results.add_page(page, offsets, n_offsets);
+			if (n_offsets > 0)
+				task.snap_pages.push_back({page, old_block});
+			return;
+		}
+		if (clean)
+			page_buf = (char*)old;
+
+		// When every result is aligned to the size of the value, the span covering them can be compared all at once
+		if (ss.results.stride == sizeof(T)) {
+			u32 hits[PAGE_SIZE / sizeof(T)];
+			int start = offsets[0];
+			int end = offsets[n_prev - 1] + sizeof(T);
+			int n_hits = compare_block<method, T>((u8*)&page_buf[start], &old[start], end - start, delta, hits);
+
+			int k = 0;
+			for (int j = 0; j < n_hits; j++) {
+				int offset = start + hits[j];
+				while (k < n_prev && offsets[k] < offset)
+					k++;
+				if (k < n_prev && offsets[k] == offset)
+					offsets[n_offsets++] = offset;
+			}
+		}
+		else {
+			for (int j = 0; j < n_prev; j++) {
+				int offset = offsets[j];
+				if (offset > PAGE_SIZE - sizeof(T))
+					continue;
+
+				T value, prev;
+				memcpy(&value, &page_buf[offset], sizeof(T));
+				memcpy(&prev, &old[offset], sizeof(T));
+				if (compare_values<method, T>(value, prev, delta))
+					offsets[n_offsets++] = offset;
+			}
+		}
+
+		task.results.add_page(page, offsets, n_offsets);
+		if (n_offsets > 0)
+			task.snap_pages.push_back({page, clean ? old_block : store_into.store((u8*)page_buf)});
+	}, skip_clean ? written.data() : nullptr);
+
+	if (finished) {
+		if (skip_clean)
+			std::swap(ss.snapshot.pages, ss.next_snapshot.pages);
+		else
+			ss.snapshot.swap(ss.next_snapshot);
+	}
+	ss.next_snapshot.clear();
+}
+
+template <typename T>
+void unknown_value_search(Search_Session& ss, SOURCE_HANDLE handle, int method, T delta) {
+	if (ss.results.total == 0) {
+		int byte_align = ss.search.byte_align;
+		if (byte_align <= 0)
+			byte_align = sizeof(T);
+
+		ss.results.set_stride(byte_align);
+		ss.snapshot.clear();
+		begin_write_tracking(ss);
+
+		Parallel_Scan scan;
+		run_parallel_scan(ss, scan, unknown_scan_chunk<T>);
+		return;
+	}
+
+	// there's nothing to compare against yet, so this pass just remembers what the current results look like
+	if (method == METHOD_UNKNOWN || ss.snapshot.pages.size() == 0) {
+		capture_snapshot(ss, handle);
+		return;
+	}
+
+	if (method == METHOD_CHANGED)
+		relative_search<METHOD_CHANGED, T>(ss, handle, delta);
+	else if (method == METHOD_UNCHANGED)
+		relative_search<METHOD_UNCHANGED, T>(ss, handle, delta);
+	else if (method == METHOD_INCREASED)
+		relative_search<METHOD_INCREASED, T>(ss, handle, delta);
+	else if (method == METHOD_DECREASED)
+		relative_search<METHOD_DECREASED, T>(ss, handle, delta);
+	else if (method == METHOD_CHANGED_BY)
+		relative_search<METHOD_CHANGED_BY, T>(ss, handle, delta);
+}
+
+// Works out the range of T values that 'within', 'rounds to' or 'truncates to' lets through.
+// The bounds are found as doubles first, then moved inwards to the nearest T that's still inside them.
+// A value exactly halfway between two rounded values could be displayed as either, so 'rounds to' lets both through.
+template <typename T>
+void get_float_bounds(int method, double value, double tolerance, T& lo, T& hi) {
+	tolerance = fabs(tolerance);
+
+	double d_lo, d_hi;
+	bool open_lo = false, open_hi = false;
+
+	if (method == METHOD_NEAR) {
+		d_lo = value - tolerance;
+		d_hi = value + tolerance;
+	}
+	else if (method == METHOD_ROUNDS_TO) {
+		d_lo = value - tolerance / 2;
+		d_hi = value + tolerance / 2;
+	}
+	else {
+		// truncating goes towards zero, so 97.3 covers [97.3, 97.4) while -97.3 covers (-97.4, -97.3]
+		d_lo = value > 0 ? value : value - tolerance;
+		d_hi = value < 0 ? value : value + tolerance;
+		open_lo = value <= 0;
+		open_hi = value >= 0;
+	}
+
+	const T inf = std::numeric_limits<T>::infinity();
+
+	lo = (T)d_lo;
+	if (lo < d_lo || (open_lo && lo == d_lo))
+		lo = std::nextafter(lo, inf);
+
+	hi = (T)d_hi;
+	if (hi > d_hi || (open_hi && hi == d_hi))
+		hi = std::nextafter(hi, -inf);
+}
+
+template <typename T>
+void get_near_bounds(T value, T epsilon, T& lo, T& hi) {
+	if constexpr (std::is_signed_v<T>) {
+		if (epsilon < 0)
+			epsilon = -epsilon;
+	}
+
+	const T min = std::numeric_limits<T>::min();
+	const T max = std::numeric_limits<T>::max();
+
+	lo = value < min + epsilon ? min : (T)(value - epsilon);
+	hi = value > max - epsilon ? max : (T)(value + epsilon);
+}
+
+// Each of the methods that allow for some tolerance comes down to a range search, so that they can be refined just like one
+template <typename T>
+void tolerant_value_search(Search_Session& ss, SOURCE_HANDLE handle, int method, s64 value1, s64 value2) {
+	T lo, hi;
+	if constexpr (std::is_floating_point_v<T>) {
+		get_float_bounds(method, *(double*)&value1, *(double*)&value2, lo, hi);
+	}
+	else {
+		lo = hi = (T)value1;
+		if (method == METHOD_NEAR)
+			get_near_bounds((T)value1, (T)value2, lo, hi);
+	}
+
+	single_value_search<METHOD_RANGE, T>(ss, handle, lo, hi);
+}
+
+// DRY: Do Repeat Yourself
+void do_single_value_search(Search_Session& ss, SOURCE_HANDLE handle) {
+	Search_Parameter sv = ss.search.single_value;
+	u32 flags = sv.flags & FIELD_FLAGS;
+
+	if (sv.method == METHOD_EQUALS) {
+		if (flags & FLAG_FLOAT) {
+			if (sv.size == 32)
+				single_value_search<METHOD_EQUALS, float>(ss, handle, (float)*(double*)&sv.value1, 0);
+			else if (sv.size == 64)
+				single_value_search<METHOD_EQUALS, double>(ss, handle, *(double*)&sv.value1, 0);
+		}
+		else if (flags & FLAG_SIGNED) {
+			if (sv.size == 8)
+				single_value_search<METHOD_EQUALS, std::int8_t>(ss, handle, *(std::int8_t*)&sv.value1, 0);
+			else if (sv.size == 16)
+				single_value_search<METHOD_EQUALS, std::int16_t>(ss, handle, *(std::int16_t*)&sv.value1, 0);
+			else if (sv.size == 32)
+				single_value_search<METHOD_EQUALS, std::int32_t>(ss, handle, *(std::int32_t*)&sv.value1, 0);
+			else
+				single_value_search<METHOD_EQUALS, std::int64_t>(ss, handle, *(std::int64_t*)&sv.value1, 0);
+		}
+		else {
+			if (sv.size == 8)
+				single_value_search<METHOD_EQUALS, std::uint8_t>(ss, handle, *(std::uint8_t*)&sv.value1, 0);
+			else if (sv.size == 16)
+				single_value_search<METHOD_EQUALS, std::uint16_t>(ss, handle, *(std::uint16_t*)&sv.value1, 0);
+			else if (sv.size == 32)
+				single_value_search<METHOD_EQUALS, std::uint32_t>(ss, handle, *(std::uint32_t*)&sv.value1, 0);
+			else
+				single_value_search<METHOD_EQUALS, std::uint64_t>(ss, handle, *(std::uint64_t*)&sv.value1, 0);
+		}
+	}
+	else if (sv.method == METHOD_RANGE) {
+		if (flags & FLAG_FLOAT) {
+			if (sv.size == 32)
+				single_value_search<METHOD_RANGE, float>(ss, handle, (float)*(double*)&sv.value1, (float)*(double*)&sv.value2);
+			else if (sv.size == 64)
+				single_value_search<METHOD_RANGE, double>(ss, handle, *(double*)&sv.value1, *(double*)&sv.value2);
+		}
+		else if (flags & FLAG_SIGNED) {
+			if (sv.size == 8)
+				single_value_search<METHOD_RANGE, std::int8_t>(ss, handle, *(std::int8_t*)&sv.value1, *(std::int8_t*)&sv.value2);
+			else if (sv.size == 16)
+				single_value_search<METHOD_RANGE, std::int16_t>(ss, handle, *(std::int16_t*)&sv.value1, *(std::int16_t*)&sv.value2);
+			else if (sv.size == 32)
+				single_value_search<METHOD_RANGE, std::int32_t>(ss, handle, *(std::int32_t*)&sv.value1, *(std::int32_t*)&sv.value2);
+			else
+				single_value_search<METHOD_RANGE, std::int64_t>(ss, handle, *(std::int64_t*)&sv.value1, *(std::int64_t*)&sv.value2);
+		}
+		else {
+			if (sv.size == 8)
+				single_value_search<METHOD_RANGE, std::uint8_t>(ss, handle, *(std::uint8_t*)&sv.value1, *(std::uint8_t*)&sv.value2);
+			else if (sv.size == 16)
+				single_value_search<METHOD_RANGE, std::uint16_t>(ss, handle, *(std::uint16_t*)&sv.value1, *(std::uint16_t*)&sv.value2);
+			else if (sv.size == 32)
+				single_value_search<METHOD_RANGE, std::uint32_t>(ss, handle, *(std::uint32_t*)&sv.value1, *(std::uint32_t*)&sv.value2);
+			else
+				single_value_search<METHOD_RANGE, std::uint64_t>(ss, handle, *(std::uint64_t*)&sv.value1, *(std::uint64_t*)&sv.value2);
+		}
+	}
+	else if (sv.method == METHOD_NEAR || sv.method == METHOD_ROUNDS_TO || sv.method == METHOD_TRUNCATES_TO) {
+		if (flags & FLAG_FLOAT) {
+			if (sv.size == 32)
+				tolerant_value_search<float>(ss, handle, sv.method, sv.value1, sv.value2);
+			else if (sv.size == 64)
+				tolerant_value_search<double>(ss, handle, sv.method, sv.value1, sv.value2);
+		}
+		else if (flags & FLAG_SIGNED) {
+			if (sv.size == 8)
+				tolerant_value_search<std::int8_t>(ss, handle, sv.method, sv.value1, sv.value2);
+			else if (sv.size == 16)
+				tolerant_value_search<std::int16_t>(ss, handle, sv.method, sv.value1, sv.value2);
+			else if (sv.size == 32)
+				tolerant_value_search<std::int32_t>(ss, handle, sv.method, sv.value1, sv.value2);
+			else
+				tolerant_value_search<std::int64_t>(ss, handle, sv.method, sv.value1, sv.value2);
+		}
+		else {
+			if (sv.size == 8)
+				tolerant_value_search<std::uint8_t>(ss, handle, sv.method, sv.value1, sv.value2);
+			else if (sv.size == 16)
+				tolerant_value_search<std::uint16_t>(ss, handle, sv.method, sv.value1, sv.value2);
+			else if (sv.size == 32)
+				tolerant_value_search<std::uint32_t>(ss, handle, sv.method, sv.value1, sv.value2);
+			else
+				tolerant_value_search<std::uint64_t>(ss, handle, sv.method, sv.value1, sv.value2);
+		}
+	}
+	else {
+		if (flags & FLAG_FLOAT) {
+			if (sv.size == 32)
+				unknown_value_search<float>(ss, handle, sv.method, (float)*(double*)&sv.value1);
+			else if (sv.size == 64)
+				unknown_value_search<double>(ss, handle, sv.method, *(double*)&sv.value1);
+		}
+		else if (flags & FLAG_SIGNED) {
+			if (sv.size == 8)
+				unknown_value_search<std::int8_t>(ss, handle, sv.method, *(std::int8_t*)&sv.value1);
+			else if (sv.size == 16)
+				unknown_value_search<std::int16_t>(ss, handle, sv.method, *(std::int16_t*)&sv.value1);
+			else if (sv.size == 32)
+				unknown_value_search<std::int32_t>(ss, handle, sv.method, *(std::int32_t*)&sv.value1);
+			else
+				unknown_value_search<std::int64_t>(ss, handle, sv.method, *(std::int64_t*)&sv.value1);
+		}
+		else {
+			if (sv.size == 8)
+				unknown_value_search<std::uint8_t>(ss, handle, sv.method, *(std::uint8_t*)&sv.value1);
+			else if (sv.size == 16)
+				unknown_value_search<std::uint16_t>(ss, handle, sv.method, *(std::uint16_t*)&sv.value1);
+			else if (sv.size == 32)
+				unknown_value_search<std::uint32_t>(ss, handle, sv.method, *(std::uint32_t*)&sv.value1);
+			else
+				unknown_value_search<std::uint64_t>(ss, handle, sv.method, *(std::uint64_t*)&sv.value1);
+		}
+	}
+}
+
+template<typename T>
+s64 roundtrip_cast(s64 in) {
+	T value = (T)in;
+	return (s64)value;
+}
+
+s64 cast(u32 flags, int size, s64 in) {
+	s64 out = 0;
+
+	if (flags & FLAG_FLOAT) {
+		out = in;
+	}
+	else if (flags & FLAG_SIGNED) {
+		if (size == 8)
+			out = roundtrip_cast<std::int8_t>(in);
+		else if (size == 16)
+			out = roundtrip_cast<std::int16_t>(in);
+		else if (size == 32)
+			out = roundtrip_cast<std::int32_t>(in);
+		else if (size == 64)
+			out = roundtrip_cast<std::int64_t>(in);
+		else
+			out = in;
+	}
+	else {
+		if (size == 8)
+			out = roundtrip_cast<std::uint8_t>(in);
+		else if (size == 16)
+			out = roundtrip_cast<std::uint16_t>(in);
+		else if (size == 32)
+			out = roundtrip_cast<std::uint32_t>(in);
+		else if (size == 64)
+			out = roundtrip_cast<std::uint64_t>(in);
+		else
+			out = in;
+	}
+
+	return out;
+}
+
+#define LOAD_S8     0
+#define LOAD_U8     1
+#define LOAD_S16    2
+#define LOAD_U16    3
+#define LOAD_S32    4
+#define LOAD_U32    5
+#define LOAD_64     6
+#define LOAD_F32    7
+#define LOAD_F64    8
+#define LOAD_BYTES  9 // any other size, assembled a byte at a time
+
+// One search parameter, reduced to where it is, how to load it and the bounds it has to fall between
+struct Field_Test {
+	int offset; // in bytes from the head of the object
+	int load;
+	int size;
+	u32 flags;
+
+	// integers pass when (u64)(value - lo) <= range, which covers both equals and range in one compare
+	u64 lo;
+	u64 range;
+
+	double f_lo;
+	double f_hi;
+
+	double selectivity; // estimated fraction of values that pass
+};
+
+// A list of search parameters compiled into the order they should be tested in, the most selective first
+struct Object_Predicate {
+	Field_Test tests[MAX_SEARCH_PARAMS];
+	int n_tests = 0;
+	int span = 1; // how many bytes from the head of an object the tests reach
+	bool impossible = false;
+
+	bool matches(const char *object) const;
+};
+
+void compile_predicate(Search_Session& ss, Object_Predicate& pred) {
+	pred.n_tests = 0;
+	pred.span = 1;
+	pred.impossible = false;
+
+	for (int i = 0; i < ss.search.n_params; i++) {
+		Search_Parameter& p = ss.search.params[i];
+		u32 flags = p.flags & FIELD_FLAGS;
+		Field_Test& t = pred.tests[pred.n_tests++];
+
+		t.offset = p.offset / 8;
+		t.size = p.size;
+		t.flags = flags;
+
+		int end = (p.offset + p.size + 7) / 8;
+		if (end > pred.span)
+			pred.span = end;
+
+		int bits = p.size < 63 ? p.size : 63;
+		double n_values = ldexp(1.0, bits);
+
+		if ((flags & FLAG_FLOAT) && (p.size == 32 || p.size == 64)) {
+			t.load = p.size == 32 ? LOAD_F32 : LOAD_F64;
+			t.f_lo = *(double*)&p.value1;
+			t.f_hi = p.method == METHOD_RANGE ? *(double*)&p.value2 : t.f_lo;
+
+			bool tolerant = p.method == METHOD_NEAR || p.method == METHOD_ROUNDS_TO || p.method == METHOD_TRUNCATES_TO;
+			if (tolerant && p.size == 32) {
+				float lo, hi;
+				get_float_bounds(p.method, *(double*)&p.value1, *(double*)&p.value2, lo, hi);
+				t.f_lo = lo;
+				t.f_hi = hi;
+			}
+			else if (tolerant) {
+				get_float_bounds(p.method, *(double*)&p.value1, *(double*)&p.value2, t.f_lo, t.f_hi);
+			}
+			// a float field can only ever equal a value that a float can hold
+			else if (p.size == 32) {
+				t.f_lo = (double)(float)t.f_lo;
+				t.f_hi = (double)(float)t.f_hi;
+			}
+
+			// there's no telling how floats are spread out, so a range is assumed to let through about half of them.
+			// The tolerant methods only let through a narrow band, so they're treated like equals.
+			t.selectivity = p.method == METHOD_RANGE ? 0.5 : 1.0 / n_values;
+			if (!(t.f_lo <= t.f_hi))
+				pred.impossible = true;
+
+			continue;
+		}
+
+		s64 lo = cast(flags, p.size, p.value1);
+		s64 hi = p.method == METHOD_RANGE ? cast(flags, p.size, p.value2) : lo;
+
+		// These aren't cast back to the field's type, so a band that reaches past either end of it doesn't wrap around,
+		//  except for 64-bit fields
+		if (p.method == METHOD_NEAR) {
+			s64 epsilon = p.value2 < 0 ? -p.value2 : p.value2;
+			lo -= epsilon;
+			hi += epsilon;
+		}
+
+		bool is_signed = (flags & FLAG_SIGNED) != 0;
+		if (p.size == 8)
+			t.load = is_signed ? LOAD_S8 : LOAD_U8;
+		else if (p.size == 16)
+			t.load = is_signed ? LOAD_S16 : LOAD_U16;
+		else if (p.size == 32)
+			t.load = is_signed ? LOAD_S32 : LOAD_U32;
+		else if (p.size == 64)
+			t.load = LOAD_64;
+		else
+			t.load = LOAD_BYTES;
+
+		// 64-bit unsigned values are the only ones that don't keep their order as an s64
+		bool in_order = p.method == METHOD_NEAR || ((p.size == 64 && !is_signed) ? (u64)lo <= (u64)hi : lo <= hi);
+		if (!in_order)
+			pred.impossible = true;
+
+		t.lo = (u64)lo;
+		t.range = (u64)hi - (u64)lo;
+		t.selectivity = ((double)t.range + 1.0) / n_values;
+	}
+
+	std::stable_sort(&pred.tests[0], &pred.tests[pred.n_tests], [](const Field_Test& a, const Field_Test& b) {
+		return a.selectivity < b.selectivity;
+	});
+}
+
+bool Object_Predicate::matches(const char *object) const {
+	for (int i = 0; i < n_tests; i++) {
+		const Field_Test& t = tests[i];
+		const char *ptr = &object[t.offset];
+		s64 value;
+
+		switch (t.load) {
+			case LOAD_S8:
+				value = *(std::int8_t*)ptr;
+				break;
+			case LOAD_U8:
+				value = *(std::uint8_t*)ptr;
+				break;
+			case LOAD_S16: {
+				std::int16_t v;
+				memcpy(&v, ptr, sizeof(v));
+				value = v;
+				break;
+			}
+			case LOAD_U16: {
+				std::uint16_t v;
+				memcpy(&v, ptr, sizeof(v));
+				value = v;
+				break;
+			}
+			case LOAD_S32: {
+				std::int32_t v;
+				memcpy(&v, ptr, sizeof(v));
+				value = v;
+				break;
+			}
+			case LOAD_U32: {
+				std::uint32_t v;
+				memcpy(&v, ptr, sizeof(v));
+				value = v;
+				break;
+			}
+			case LOAD_64:
+				memcpy(&value, ptr, sizeof(value));
+				break;
+			case LOAD_F32: {
+				float f;
+				memcpy(&f, ptr, sizeof(f));
+				if (!(f >= t.f_lo && f <= t.f_hi))
+					return false;
+				continue;
+			}
+			case LOAD_F64: {
+				double d;
+				memcpy(&d, ptr, sizeof(d));
+				if (!(d >= t.f_lo && d <= t.f_hi))
+					return false;
+				continue;
+			}
+			default: {
+				value = 0;
+				for (int k = 0; k < t.size / 8; k++)
+					value |= (s64)(ptr[k] & 0xff) << (s64)(8*k);
+				value = cast(t.flags, t.size, value);
+				break;
+			}
+		}
+
+		if ((u64)value - t.lo > t.range)
+			return false;
+	}
+
+	return true;
+}
+
+int get_object_byte_inc(Search_Session& ss) {
+	int byte_inc = ss.search.byte_align;
+	if (byte_inc <= 0)
+		byte_inc = ss.search.record->total_size / 8;
+
+	return byte_inc > 0 ? byte_inc : 1;
+}
+
+void object_scan_chunk(void *data, int worker, int idx) {
+	auto scan = (Parallel_Scan*)data;
+	if (!scan->begin_chunk(worker, idx))
+		return;
+
+	Search_Session& ss = *scan->session;
+
+	Scan_Chunk& chunk = scan->chunks[idx];
+	const Stream_Block& block = scan->read_chunk(worker, idx);
+	auto pred = (Object_Predicate*)scan->extra;
+	int span = pred->span;
+
+	// keep to the same lattice of heads as if the whole range were scanned in one go
+	u64 byte_inc = get_object_byte_inc(ss);
+	u64 head = chunk.origin + ((chunk.start - chunk.origin + byte_inc - 1) / byte_inc) * byte_inc;
+
+	u16 offsets[PAGE_SIZE];
+	int n_offsets = 0;
+	u64 page = head & ~(PAGE_SIZE - 1);
+
+	// objects that end before readable_end are entirely made of pages that could be read
+	u64 readable_end = 0;
+	u64 block_end = block.address + block.size;
+
+	for (; head < chunk.end; head += byte_inc) {
+		if (head - page >= PAGE_SIZE) {
+			chunk.results.add_page(page, offsets, n_offsets);
+			n_offsets = 0;
+			page = head & ~(PAGE_SIZE - 1);
+		}
+
+		if (head + span > readable_end) {
+			if (readable_end <= head) {
+				// skip ahead to the next page that could be read
+				int p = (int)((head - block.address) / PAGE_SIZE);
+				if (block.pages[p].retrieved <= 0)
+					continue;
+
+				readable_end = block.pages[p].address;
+			}
+
+			while (readable_end < block_end && readable_end < head + span) {
+				int p = (int)((readable_end - block.address) / PAGE_SIZE);
+				if (block.pages[p].retrieved <= 0)
+					break;
+
+				readable_end += PAGE_SIZE;
+			}
+
+			if (head + span > readable_end)
+				continue;
+		}
+
+		if (pred->matches(&block.data[head - block.address]))
+			offsets[n_offsets++] = (u16)(head - page);
+	}
+
+	chunk.results.add_page(page, offsets, n_offsets);
+}
+
+// TODO: Support both endians, bitfields, arrays (including string literals)
+void do_object_search(Search_Session& ss, SOURCE_HANDLE handle) {
+	Object_Predicate pred;
+	compile_predicate(ss, pred);
+
+	// object searches don't compare against snapshots
+	ss.snapshot.clear();
+
+	if (pred.impossible) {
+		ss.results.clear();
+		return;
+	}
+
+	if (ss.results.total == 0) {
+		ss.results.set_stride(get_object_byte_inc(ss));
+
+		Parallel_Scan scan;
+		scan.extra = (void*)&pred;
+		run_parallel_scan(ss, scan, object_scan_chunk, 0, pred.span);
+		return;
+	}
+
+	begin_refinement(ss);
+
+	// each page of results needs enough memory after it to hold an object that starts at the very end of the page
+	int window = (PAGE_SIZE - 1 + pred.span + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+	read_result_pages(ss, handle, window, [&](int i, char *buf, int retrieved, Refine_Task& task) {
+		u16 offsets[PAGE_SIZE];
+		int n_prev = ss.prev_results.get_offsets(i, offsets);
+		int n_offsets = 0;
+
+		for (int j = 0; j < n_prev; j++) {
+			int offset = offsets[j];
+			if (offset + pred.span <= retrieved && pred.matches(&buf[offset]))
+				offsets[n_offsets++] = offset;
+		}
+
+		task.results.add_page(ss.prev_results.pages[i].address, offsets, n_offsets);
+	});
+}
+
+int get_pattern_byte_inc(Search_Session& ss) {
+	return ss.search.byte_align > 0 ? ss.search.byte_align : 1;
+}
+
+int get_pattern_span(Search_Session& ss) {
+	int span = 1;
+	for (int i = 0; i < ss.search.n_patterns; i++) {
+		if (ss.search.patterns[i].size > span)
+			span = ss.search.patterns[i].size;
+	}
+	return span;
+}
+
+// Returns which pattern matches at 'buf', or -1. Later patterns are tried first, since they're the longer encodings of the same text.
+int match_patterns(Search_Session& ss, const u8 *buf, int avail) {
+	for (int i = ss.search.n_patterns - 1; i >= 0; i--) {
+		if (ss.search.patterns[i].size <= avail && pattern_matches(buf, ss.search.patterns[i]))
+			return i;
+	}
+	return -1;
+}
+
+// Finds each pattern one page at a time, so that each page's hits can go straight into the results.
+// A match can carry on past the end of the page or the chunk, as long as every page it covers could be read.
+void pattern_scan_chunk(void *data, int worker, int idx) {
+	auto scan = (Parallel_Scan*)data;
+	if (!scan->begin_chunk(worker, idx))
+		return;
+
+	Search_Session& ss = *scan->session;
+
+	Scan_Chunk& chunk = scan->chunks[idx];
+	const Stream_Block& block = scan->read_chunk(worker, idx);
+	u32 *hits = scan->workers[worker].hits;
+	u16 offsets[PAGE_SIZE];
+
+	u16 found[MAX_SEARCH_PATTERNS][PAGE_SIZE];
+	int n_found[MAX_SEARCH_PATTERNS] = {0};
+
+	int byte_inc = get_pattern_byte_inc(ss);
+	int span = get_pattern_span(ss);
+	int n_pages = (int)((chunk.end - block.address + PAGE_SIZE - 1) / PAGE_SIZE);
+
+	for (int i = 0; i < n_pages; i++) {
+		if (block.pages[i].retrieved <= 0)
+			continue;
+
+		// find out how far the memory from the start of this page can be read without a gap
+		u64 page = block.pages[i].address;
+		u64 readable_end = page;
+		for (int p = i; p < block.n_pages && readable_end < page + PAGE_SIZE + span - 1; p++) {
+			int retrieved = block.pages[p].retrieved;
+			if (retrieved <= 0)
+				break;
+
+			readable_end += retrieved;
+			if (retrieved < PAGE_SIZE)
+				break;
+		}
+
+		u64 start = page < chunk.start ? chunk.start : page;
+		u64 end = page + PAGE_SIZE < chunk.end ? page + PAGE_SIZE : chunk.end;
+		if (start >= end)
+			continue;
+
+		const u8 *buf = (u8*)&block.data[start - block.address];
+
+		for (int k = 0; k < ss.search.n_patterns; k++) {
+			const Byte_Pattern& pattern = ss.search.patterns[k];
+			n_found[k] = 0;
+
+			// the buffer only needs to reach far enough for a match that starts at the last position
+			u64 buf_end = end + pattern.size - 1;
+			if (buf_end > readable_end)
+				buf_end = readable_end;
+			if (buf_end <= start)
+				continue;
+
+			int n_hits = scan_pattern(buf, (int)(buf_end - start), pattern, hits);
+			for (int j = 0; j < n_hits; j++) {
+				u64 address = start + hits[j];
+				if (byte_inc == 1 || address % byte_inc == 0)
+					found[k][n_found[k]++] = (u16)(address - page);
+			}
+		}
+
+		// the second pattern's hits are also kept by themselves, to tell which encoding each result is in
+		int n_offsets = std::set_union(&found[0][0], &found[0][n_found[0]], &found[1][0], &found[1][n_found[1]], offsets) - offsets;
+
+		chunk.results.add_page(page, offsets, n_offsets);
+		chunk.alt_results.add_page(page, found[1], n_found[1]);
+	}
+}
+
+void do_pattern_search(Search_Session& ss, SOURCE_HANDLE handle) {
+	// pattern searches don't compare against snapshots
+	ss.snapshot.clear();
+
+	int span = get_pattern_span(ss);
+
+	if (ss.results.total == 0) {
+		ss.results.set_stride(get_pattern_byte_inc(ss));
+
+		Parallel_Scan scan;
+		run_parallel_scan(ss, scan, pattern_scan_chunk, PAGE_SIZE, span - 1);
+		return;
+	}
+
+	begin_refinement(ss);
+
+	int window = (PAGE_SIZE - 1 + span + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+	read_result_pages(ss, handle, window, [&](int i, char *buf, int retrieved, Refine_Task& task) {
+		u16 offsets[PAGE_SIZE];
+		u16 alt_offsets[PAGE_SIZE];
+		int n_prev = ss.prev_results.get_offsets(i, offsets);
+		int n_offsets = 0;
+		int n_alt = 0;
+
+		for (int j = 0; j < n_prev; j++) {
+			int offset = offsets[j];
+			int which = match_patterns(ss, (u8*)&buf[offset], retrieved - offset);
+			if (which >= 0)
+				offsets[n_offsets++] = offset;
+			if (which == 1)
+				alt_offsets[n_alt++] = offset;
+		}
+
+		u64 page = ss.prev_results.pages[i].address;
+		task.results.add_page(page, offsets, n_offsets);
+		task.alt_results.add_page(page, alt_offsets, n_alt);
+	});
+}
+
+int get_group_align(Search_Session& ss, int idx) {
+	return ss.search.byte_align > 0 ? ss.search.byte_align : ss.search.group.values[idx].size;
+}
+
+// Whether a group starts at 'buf', which is at 'address'. 'avail' is how many bytes from there on can be read.
+// Most places don't have any of the values right at the start, so that's checked before looking through the window.
+// Puts each value that's left (going through group.order from 'idx') somewhere in the window that none of the others cover, backtracking when one doesn't fit.
+// starts[i] is where values[i] has been put, or -1 if it hasn't been yet.
+static bool place_group_values(const Value_Group& group, const int *aligns, const u8 *buf, u64 address, int window, int *starts, int idx) {
+	if (idx == group.n_values)
+		return true;
+
+	int i = group.order[idx];
+	if (starts[i] >= 0)
+		return place_group_values(group, aligns, buf, address, window, starts, idx + 1);
+
+	const Byte_Pattern& v = group.values[i];
+	int align = aligns[i];
+
+	// identical values only get placed in ascending order, so that the same placement isn't tried again for every way of swapping them around
+	int lo = group.same_as_prev[idx] ? starts[group.order[idx-1]] + 1 : 0;
+	int q = lo + (int)((align - (address + lo) % align) % align);
+
+	for (; q + v.size <= window; q += align) {
+		if (!pattern_matches(&buf[q], v))
+			continue;
+
+		bool is_free = true;
+		for (int j = 0; j < group.n_values && is_free; j++)
+			is_free = starts[j] < 0 || q + v.size <= starts[j] || q >= starts[j] + group.values[j].size;
+
+		if (!is_free)
+			continue;
+
+		starts[i] = q;
+		if (place_group_values(group, aligns, buf, address, window, starts, idx + 1))
+			return true;
+
+		starts[i] = -1;
+	}
+
+	return false;
+}
+
+bool group_starts_at(Search_Session& ss, const u8 *buf, u64 address, int avail) {
+	const Value_Group& group = ss.search.group;
+	int window = group.window < avail ? group.window : avail;
 
-static void *thread = nullptr;
-static bool started = false;
-static bool running = false;
+	if (group.ordered) {
+		const Byte_Pattern& first = group.values[0];
+		if (first.size > window || address % get_group_align(ss, 0) != 0 || !pattern_matches(buf, first))
+			return false;
 
-static u64 *results = nullptr;
-static int n_results = 0;
+		// each value after the first has to start after the one before it ends
+		int pos = first.size;
+		for (int i = 1; i < group.n_values; i++) {
+			const Byte_Pattern& v = group.values[i];
+			int align = get_group_align(ss, i);
 
-static u64 *prev_results = nullptr;
-static int n_prev_results = 0;
+			int q = pos + (int)((align - (address + pos) % align) % align);
+			while (q + v.size <= window && !pattern_matches(&buf[q], v))
+				q += align;
 
-static Search search;
-static std::vector<std::pair<u64, u64>> ranges;
+			if (q + v.size > window)
+				return false;
 
-void perform_search();
+			pos = q + v.size;
+		}
 
-void start_search(Search& s, std::vector<Region> const& regions) {
-	if (running)
-		return;
+		return true;
+	}
 
-	ranges.resize(0);
-	for (auto& reg : regions)
-		ranges.push_back(std::make_pair<u64, u64>((u64)reg.base, (u64)reg.size));
+	int aligns[MAX_GROUP_VALUES];
+	int starts[MAX_GROUP_VALUES];
+	for (int i = 0; i < group.n_values; i++) {
+		aligns[i] = get_group_align(ss, i);
+		starts[i] = -1;
+	}
 
-	std::sort(ranges.begin(), ranges.end(), [](std::pair<u64, u64>& a, std::pair<u64, u64>& b) {
-		return a.first < b.first;
-	});
+	// one of the values has to be right at the start. Of several identical values, only the first needs trying there.
+	for (int idx = 0; idx < group.n_values; idx++) {
+		int k = group.order[idx];
+		const Byte_Pattern& v = group.values[k];
+		if (group.same_as_prev[idx] || v.size > window || address % aligns[k] != 0 || !pattern_matches(buf, v))
+			continue;
 
-	search.params = s.params;
-	if (search.params) {
-		search.n_params = s.n_params;
-		search.record = s.record;
+		starts[k] = 0;
+		if (place_group_values(group, aligns, buf, address, window, starts, 0))
+			return true;
+
+		starts[k] = -1;
 	}
-	else
-		search.single_value = s.single_value;
 
-	search.byte_align = s.byte_align;
+	return false;
+}
+
+// How many of the 'size' bytes from 'address' on can be read out of the block without a gap
+int get_readable_size(const Stream_Block& block, u64 address, int size) {
+	u64 end = address;
+	for (int p = (int)((address - block.address) / PAGE_SIZE); p < block.n_pages && end < address + size; p++) {
+		int retrieved = block.pages[p].retrieved;
+		if (retrieved <= 0)
+			break;
 
-	search.start_addr = s.start_addr;
-	search.end_addr = s.end_addr;
+		end = block.pages[p].address + retrieved;
+		if (retrieved < PAGE_SIZE)
+			break;
+	}
 
-	search.source_type = s.source_type;
-	search.pid = s.pid;
-	search.identifier = s.identifier;
+	if (end <= address)
+		return 0;
 
-	auto func = [](void *data) {
-		perform_search();
-		return (THREAD_RETURN_TYPE)0;
-	};
-	start_thread(&thread, nullptr, func);
+	return end - address < size ? (int)(end - address) : size;
 }
 
-bool check_search_running() {
-	return running;
+// Only the anchor is looked for across the whole chunk, the same way a pattern would be.
+// Any group that an anchor belongs to has to start within a window before it, so only those places are checked in full.
+// A group belongs to the chunk it starts in, which means its anchor can be up to a window past the end of the chunk.
+// When the anchor sits on its own alignment, the typed kernels that single value searches use can find it,
+//  otherwise it falls back to the byte pattern kernel. buf must be aligned to the anchor size in the first case.
+static int scan_group_anchor(const u8 *buf, int size, const Byte_Pattern& anchor, bool typed, u32 *hits) {
+	if (!typed)
+		return scan_pattern(buf, size, anchor, hits);
+
+	u64 v = 0;
+	memcpy(&v, anchor.bytes, anchor.size);
+
+	switch (anchor.size) {
+		case 1: return scan_block<METHOD_EQUALS, std::uint8_t>(buf, size, (std::uint8_t)v, 0, hits);
+		case 2: return scan_block<METHOD_EQUALS, std::uint16_t>(buf, size, (std::uint16_t)v, 0, hits);
+		case 4: return scan_block<METHOD_EQUALS, std::uint32_t>(buf, size, (std::uint32_t)v, 0, hits);
+		case 8: return scan_block<METHOD_EQUALS, std::uint64_t>(buf, size, v, 0, hits);
+	}
+	return scan_pattern(buf, size, anchor, hits);
 }
 
-bool check_search_finished() {
-	bool finished = started && !running;
-	if (finished)
-		started = false;
+void group_scan_chunk(void *data, int worker, int idx) {
+	auto scan = (Parallel_Scan*)data;
+	if (!scan->begin_chunk(worker, idx))
+		return;
 
-	return finished;
+	Search_Session& ss = *scan->session;
+	const Value_Group& group = ss.search.group;
+	const Byte_Pattern& anchor = group.values[group.anchor];
+	int anchor_align = get_group_align(ss, group.anchor);
+	bool typed = anchor_align == anchor.size;
+	int stride = ss.results.stride;
+
+	Scan_Chunk& chunk = scan->chunks[idx];
+	const Stream_Block& block = scan->read_chunk(worker, idx);
+	u32 *hits = scan->workers[worker].hits;
+
+	u16 offsets[PAGE_SIZE];
+	int n_offsets = 0;
+	u64 results_page = 0;
+
+	u64 anchor_end = chunk.end + group.window - anchor.size;
+	u64 next_start = chunk.start; // where the next group to be checked can start, so that no place gets checked twice
+
+	int n_pages = (int)((anchor_end - block.address + PAGE_SIZE - 1) / PAGE_SIZE);
+	if (n_pages > block.n_pages)
+		n_pages = block.n_pages;
+
+	for (int i = 0; i < n_pages; i++) {
+		if (block.pages[i].retrieved <= 0)
+			continue;
+
+		u64 page = block.pages[i].address;
+		u64 start = page < chunk.start ? chunk.start : page;
+		if (typed)
+			start = (start + anchor_align - 1) & ~(u64)(anchor_align - 1);
+
+		u64 end = page + PAGE_SIZE < anchor_end ? page + PAGE_SIZE : anchor_end;
+		if (start >= end)
+			continue;
+
+		int size = get_readable_size(block, start, (int)(end - start) + anchor.size - 1);
+		int n_hits = scan_group_anchor((u8*)&block.data[start - block.address], size, anchor, typed, hits);
+
+		for (int j = 0; j < n_hits; j++) {
+			u64 hit = start + hits[j];
+			if (hit % anchor_align != 0)
+				continue;
+
+			u64 lo = hit + anchor.size > group.window ? hit + anchor.size - group.window : 0;
+			if (lo < next_start)
+				lo = next_start;
+
+			u64 hi = hit < chunk.end ? hit + 1 : chunk.end;
+			u64 addr = (lo + stride - 1) & ~(u64)(stride - 1);
+
+			for (; addr < hi; addr += stride) {
+				int avail = get_readable_size(block, addr, group.window);
+				if (!group_starts_at(ss, (u8*)&block.data[addr - block.address], addr, avail))
+					continue;
+
+				u64 addr_page = addr & ~(u64)(PAGE_SIZE - 1);
+				if (n_offsets > 0 && addr_page != results_page) {
+					chunk.results.add_page(results_page, offsets, n_offsets);
+					n_offsets = 0;
+				}
+
+				results_page = addr_page;
+				offsets[n_offsets++] = (u16)(addr - addr_page);
+			}
+
+			if (hi > next_start)
+				next_start = hi;
+		}
+	}
+
+	chunk.results.add_page(results_page, offsets, n_offsets);
 }
 
-void get_search_results(std::vector<u64>& results_vec) {
-	if (!results)
+void do_group_search(Search_Session& ss, SOURCE_HANDLE handle) {
+	// group searches don't compare against snapshots
+	ss.snapshot.clear();
+
+	const Value_Group& group = ss.search.group;
+
+	if (ss.results.total == 0) {
+		int align = get_group_align(ss, 0);
+		for (int i = 1; i < group.n_values; i++) {
+			if (get_group_align(ss, i) < align)
+				align = get_group_align(ss, i);
+		}
+		ss.results.set_stride(align);
+
+		Parallel_Scan scan;
+		run_parallel_scan(ss, scan, group_scan_chunk, PAGE_SIZE, group.window - 1);
 		return;
+	}
+
+	begin_refinement(ss);
+
+	int window = (PAGE_SIZE - 1 + group.window + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
 
-	results_vec.resize(n_results);
-	if (n_results)
-		memcpy(results_vec.data(), results, n_results * sizeof(u64));
+	read_result_pages(ss, handle, window, [&](int i, char *buf, int retrieved, Refine_Task& task) {
+		u16 offsets[PAGE_SIZE];
+		int n_prev = ss.prev_results.get_offsets(i, offsets);
+		int n_offsets = 0;
+		u64 page = ss.prev_results.pages[i].address;
+
+		for (int j = 0; j < n_prev; j++) {
+			int offset = offsets[j];
+			if (offset < retrieved && group_starts_at(ss, (u8*)&buf[offset], page + offset, retrieved - offset))
+				offsets[n_offsets++] = offset;
+		}
+
+		task.results.add_page(page, offsets, n_offsets);
+	});
 }
 
-void reset_search() {
-	n_results = 0;
+struct Pointer_Entry {
+	u64 value;
+	u64 address;
+};
+
+static bool points_into_ranges(const std::vector<std::pair<u64, u64>>& ranges, u64 value) {
+	auto it = std::upper_bound(ranges.begin(), ranges.end(), value, [](u64 v, const std::pair<u64, u64>& r) {
+		return v < r.first;
+	});
+
+	return it != ranges.begin() && value - (it - 1)->first < (it - 1)->second;
 }
 
-void exit_search() {
-	if (results) {
-		delete[] results;
-		results = nullptr;
-	}
-	if (prev_results) {
-		delete[] prev_results;
-		prev_results = nullptr;
+// Every aligned 8-byte value in the chunk that points somewhere readable, sorted by where it points
+void pointer_scan_chunk(void *data, int worker, int idx) {
+	auto scan = (Parallel_Scan*)data;
+	if (!scan->begin_chunk(worker, idx))
+		return;
+
+	Search_Session& ss = *scan->session;
+	auto& pointers = ((std::vector<Pointer_Entry>*)scan->extra)[idx];
+
+	int byte_align = ss.search.byte_align > 0 ? ss.search.byte_align : sizeof(u64);
+
+	// most values aren't anywhere near a region, so they're ruled out before the ranges are searched through
+	const auto& ranges = ss.ranges;
+	u64 lowest = ranges.front().first;
+	u64 highest = ranges.back().first + ranges.back().second;
+
+	Scan_Chunk& chunk = scan->chunks[idx];
+	const Stream_Block& block = scan->read_chunk(worker, idx);
+
+	int n_pages = (int)((chunk.end - block.address + PAGE_SIZE - 1) / PAGE_SIZE);
+	int offset = (int)(chunk.start - block.address) & ~(sizeof(u64) - 1);
+
+	for (int i = 0; i < n_pages; i++, offset = 0) {
+		if (block.pages[i].retrieved <= 0)
+			continue;
+
+		u64 page = block.pages[i].address;
+		const char *buf = (const char*)block.pages[i].data;
+
+		int limit = PAGE_SIZE;
+		if (chunk.end - page < PAGE_SIZE)
+			limit = (int)(chunk.end - page);
+
+		for (int j = offset; j <= PAGE_SIZE - (int)sizeof(u64) && j < limit; j += byte_align) {
+			u64 value;
+			memcpy(&value, &buf[j], sizeof(u64));
+			if (value - lowest < highest - lowest && points_into_ranges(ranges, value))
+				pointers.push_back({value, page + j});
+		}
 	}
+
+	std::sort(pointers.begin(), pointers.end(), [](const Pointer_Entry& a, const Pointer_Entry& b) {
+		return a.value < b.value;
+	});
+
+	ss.progress_matches += pointers.size();
 }
 
-struct Scan_Range {
-	u64 start;
-	int first_range;
-	int last_range;
+struct Pointer_Merge {
+	std::vector<Pointer_Entry> *lists;
+	int n_lists;
+	int step;
 };
 
-Scan_Range isolate_scan_ranges() {
-	Scan_Range scan = {
-		.start = search.start_addr,
-		.first_range = -1,
-		.last_range = -1
+// Merges list[i] with list[i + step], leaving the result in list[i]
+void merge_pointers_task(void *data, int worker, int idx) {
+	auto merge = (Pointer_Merge*)data;
+	int a = idx * merge->step * 2;
+	int b = a + merge->step;
+	if (b >= merge->n_lists)
+		return;
+
+	auto& first = merge->lists[a];
+	auto& second = merge->lists[b];
+
+	std::vector<Pointer_Entry> out(first.size() + second.size());
+	std::merge(first.begin(), first.end(), second.begin(), second.end(), out.begin(), [](const Pointer_Entry& x, const Pointer_Entry& y) {
+		return x.value < y.value;
+	});
+
+	first.swap(out);
+	std::vector<Pointer_Entry>().swap(second);
+}
+
+// Each chunk's pointers were sorted by the worker that found them, so they only need merging, which is done in pairs at once
+static void merge_pointer_lists(std::vector<std::vector<Pointer_Entry>>& lists) {
+	Pointer_Merge merge = {
+		.lists = lists.data(),
+		.n_lists = (int)lists.size(),
+		.step = 1
 	};
 
-	for (auto& r : ranges) {
-		scan.first_range++;
-		if (scan.start < r.first + r.second) {
-			if (scan.start < r.first)
-				scan.start = r.first;
-			break;
-		}
+	for (; merge.step < merge.n_lists; merge.step *= 2) {
+		int n_tasks = (merge.n_lists + merge.step * 2 - 1) / (merge.step * 2);
+		run_tasks(&merge, merge_pointers_task, n_tasks, get_worker_count());
 	}
-	for (auto& r : ranges) {
-		if (search.end_addr < r.first)
-			break;
+}
 
-		scan.last_range++;
-	}
+static const Pointer_Module *find_pointer_module(Search_Session& ss, u64 address) {
+	auto it = std::upper_bound(ss.modules.begin(), ss.modules.end(), address, [](u64 addr, const Pointer_Module& m) {
+		return addr < m.start;
+	});
 
-	return scan;
+	if (it == ss.modules.begin() || address >= (it - 1)->end)
+		return nullptr;
+
+	return &*(it - 1);
 }
 
-template <int method, typename T>
-void single_value_search(SOURCE_HANDLE handle, T v1, T v2) {
-	int byte_align = search.byte_align;
-	if (byte_align <= 0)
-		byte_align = sizeof(T);
+static std::string make_path_label(Search_Session& ss, const Pointer_Path& path) {
+	char buf[24];
+	std::string label(path.depth, '[');
+	label += ss.module_names[path.module];
 
-	char *buf = new char[PAGE_SIZE]();
+	snprintf(buf, 24, "+0x%llx", (unsigned long long)path.base_offset);
+	label += buf;
+
+	for (int i = 0; i < path.depth; i++) {
+		snprintf(buf, 24, "]+0x%x", path.offsets[i]);
+		label += buf;
+	}
 
-	if (n_results == 0) {
-		auto scan = isolate_scan_ranges();
+	return label;
+}
 
-		u64 addr = scan.start;
-		for (int i = scan.first_range; i <= scan.last_range && addr <= search.end_addr; i++) {
-			u64 range_end = ranges[i].first + ranges[i].second;
-			if (search.end_addr < range_end)
-				range_end = search.end_addr;
+static void set_pointer_results(Search_Session& ss) {
+	std::sort(ss.paths.begin(), ss.paths.end(), [](const Pointer_Path& a, const Pointer_Path& b) {
+		return a.base < b.base;
+	});
 
-			u64 page = addr & ~(PAGE_SIZE - 1);
-			int offset = (int)(addr - page) & ~(sizeof(T) - 1);
+	ss.path_labels.resize(ss.paths.size());
+	for (int i = 0; i < ss.paths.size(); i++)
+		ss.path_labels[i] = make_path_label(ss, ss.paths[i]);
 
-			for (; page < range_end; page += PAGE_SIZE) {
-				int retrieved = read_page(handle, search.source_type, page, buf);
-				if (retrieved <= 0)
-					continue;
+	ss.results.clear();
+	ss.alt_results.clear();
+	ss.results.set_stride(1);
 
-				for (int j = offset; j <= PAGE_SIZE - sizeof(T); j += byte_align) {
-					T value = *(T*)(&buf[j]);
-					if constexpr (method == METHOD_EQUALS) {
-						if (value == v1) {
-							results[n_results++] = page + (u64)j;
-							if (n_results >= MAX_SEARCH_RESULTS)
-								goto done_single;
-						}
-					}
-					else {
-						if (value >= v1 && value <= v2) {
-							results[n_results++] = page + (u64)j;
-							if (n_results >= MAX_SEARCH_RESULTS)
-								goto done_single;
-						}
-					}
-				}
-			}
+	u16 offsets[PAGE_SIZE];
+	int n = 0;
+	u64 page = 0;
 
-			if (i < scan.last_range)
-				addr = ranges[i + 1].first;
+	for (auto& p : ss.paths) {
+		u64 p_page = p.base & ~(u64)(PAGE_SIZE - 1);
+		if (n > 0 && p_page != page) {
+			ss.results.add_page(page, offsets, n);
+			n = 0;
 		}
+
+		page = p_page;
+		offsets[n++] = (u16)(p.base - page);
 	}
-	else {
-		n_prev_results = n_results;
-		if (!prev_results)
-			prev_results = new u64[MAX_SEARCH_RESULTS];
 
-		memcpy(prev_results, results, n_prev_results * sizeof(u64));
-		n_results = 0;
+	if (n > 0)
+		ss.results.add_page(page, offsets, n);
+
+	ss.progress_matches = ss.results.total;
+}
 
-		u64 page = 0;
-		bool fail = false;
+// Works back from the target one level at a time. Each address is only ever reached once, by the shortest chain there is to it,
+//  so a pass can't go around in circles, and each address in a module gives at most one path.
+static void find_pointer_paths(Search_Session& ss, const std::vector<Pointer_Entry>& map) {
+	struct Node {
+		u64 address;
+		int parent;
+		int offset; // how far the next address along is from where this one points
+	};
 
-		for (int i = 0; i < n_prev_results && n_results < MAX_SEARCH_RESULTS; i++) {
-			u64 addr = prev_results[i];
-			u64 p = addr & ~(PAGE_SIZE - 1);
-			int offset = (int)(addr - p);//(int)(addr & (u64)(PAGE_SIZE - 1));
+	std::vector<Node> nodes;
+	std::unordered_map<u64, int> visited;
 
-			if (i == 0 || p > page) {
-				page = p;
-				int retrieved = read_page(handle, search.source_type, page, buf);
-				fail = retrieved <= 0;
-			}
-			if (!fail) {
-				T value = *(T*)(&buf[offset]);
-				if constexpr (method == METHOD_EQUALS) {
-					if (value == v1)
-						results[n_results++] = addr;
-				}
-				else {
-					if (value >= v1 && value <= v2)
-						results[n_results++] = addr;
+	nodes.push_back({ss.search.pointer_target, -1, 0});
+	visited[ss.search.pointer_target] = 0;
+
+	u64 max_offset = ss.search.max_offset > 0 ? ss.search.max_offset : 0;
+	int level_start = 0;
+
+	for (int depth = 1; depth <= ss.search.max_depth; depth++) {
+		int level_end = nodes.size();
+		ss.progress_done = depth - 1;
+
+		for (int n = level_start; n < level_end && !ss.cancelled; n++) {
+			u64 target = nodes[n].address;
+			u64 lowest = target >= max_offset ? target - max_offset : 0;
+
+			auto it = std::lower_bound(map.begin(), map.end(), lowest, [](const Pointer_Entry& e, u64 v) {
+				return e.value < v;
+			});
+
+			for (; it != map.end() && it->value <= target; it++) {
+				if (nodes.size() >= MAX_POINTER_NODES || ss.paths.size() >= MAX_POINTER_PATHS)
+					break;
+				if (visited.find(it->address) != visited.end())
+					continue;
+
+				visited[it->address] = nodes.size();
+				nodes.push_back({it->address, n, (int)(target - it->value)});
+
+				const Pointer_Module *module = find_pointer_module(ss, it->address);
+				if (!module)
+					continue;
+
+				Pointer_Path path = {
+					.module = module->name_idx,
+					.base_offset = it->address - module->base,
+					.base = it->address,
+					.depth = depth
+				};
+
+				int node = nodes.size() - 1;
+				for (int i = 0; i < depth; i++) {
+					path.offsets[i] = nodes[node].offset;
+					node = nodes[node].parent;
 				}
+
+				ss.paths.push_back(path);
 			}
 		}
-	}
 
-done_single:
-	delete[] buf;
+		level_start = level_end;
+		if (level_start == nodes.size() || ss.cancelled)
+			break;
+	}
 }
 
-// DRY: Do Repeat Yourself
-void do_single_value_search(SOURCE_HANDLE handle) {
-	Search_Parameter sv = search.single_value;
-	u32 flags = sv.flags & FIELD_FLAGS;
-
-	if (sv.method == METHOD_EQUALS) {
-		if (flags & FLAG_FLOAT) {
-			if (sv.size == 32)
-				single_value_search<METHOD_EQUALS, float>(handle, *(float*)&sv.value1, 0);
-			else if (sv.size == 64)
-				single_value_search<METHOD_EQUALS, double>(handle, *(double*)&sv.value1, 0);
-		}
-		else if (flags & FLAG_SIGNED) {
-			if (sv.size == 8)
-				single_value_search<METHOD_EQUALS, std::int8_t>(handle, *(std::int8_t*)&sv.value1, 0);
-			else if (sv.size == 16)
-				single_value_search<METHOD_EQUALS, std::int16_t>(handle, *(std::int16_t*)&sv.value1, 0);
-			else if (sv.size == 32)
-				single_value_search<METHOD_EQUALS, std::int32_t>(handle, *(std::int32_t*)&sv.value1, 0);
-			else
-				single_value_search<METHOD_EQUALS, std::int64_t>(handle, *(std::int64_t*)&sv.value1, 0);
+// A later pass keeps the paths that still lead to the target, which can be somewhere else by now (eg. after the process has been restarted).
+// Every path is followed one pointer at a time, with each level read in one batch.
+static void check_pointer_paths(Search_Session& ss, SOURCE_HANDLE handle) {
+	std::vector<Pointer_Path> kept;
+	std::vector<u64> addrs;
+	std::vector<Span> spans;
+	std::vector<u64> values;
+
+	for (auto& p : ss.paths) {
+		// the module might have been loaded somewhere else this time
+		u64 base = 0;
+		for (auto& m : ss.modules) {
+			if (m.name_idx == p.module) {
+				base = m.base;
+				break;
+			}
 		}
-		else {
-			if (sv.size == 8)
-				single_value_search<METHOD_EQUALS, std::uint8_t>(handle, *(std::uint8_t*)&sv.value1, 0);
-			else if (sv.size == 16)
-				single_value_search<METHOD_EQUALS, std::uint16_t>(handle, *(std::uint16_t*)&sv.value1, 0);
-			else if (sv.size == 32)
-				single_value_search<METHOD_EQUALS, std::uint32_t>(handle, *(std::uint32_t*)&sv.value1, 0);
-			else
-				single_value_search<METHOD_EQUALS, std::uint64_t>(handle, *(std::uint64_t*)&sv.value1, 0);
+
+		if (base) {
+			kept.push_back(p);
+			kept.back().base = base + p.base_offset;
+			addrs.push_back(kept.back().base);
 		}
 	}
-	else if (sv.method == METHOD_RANGE) {
-		if (flags & FLAG_FLOAT) {
-			if (sv.size == 32)
-				single_value_search<METHOD_RANGE, float>(handle, *(float*)&sv.value1, *(float*)&sv.value2);
-			else if (sv.size == 64)
-				single_value_search<METHOD_RANGE, double>(handle, *(double*)&sv.value1, *(double*)&sv.value2);
-		}
-		else if (flags & FLAG_SIGNED) {
-			if (sv.size == 8)
-				single_value_search<METHOD_RANGE, std::int8_t>(handle, *(std::int8_t*)&sv.value1, *(std::int8_t*)&sv.value2);
-			else if (sv.size == 16)
-				single_value_search<METHOD_RANGE, std::int16_t>(handle, *(std::int16_t*)&sv.value1, *(std::int16_t*)&sv.value2);
-			else if (sv.size == 32)
-				single_value_search<METHOD_RANGE, std::int32_t>(handle, *(std::int32_t*)&sv.value1, *(std::int32_t*)&sv.value2);
-			else
-				single_value_search<METHOD_RANGE, std::int64_t>(handle, *(std::int64_t*)&sv.value1, *(std::int64_t*)&sv.value2);
+
+	ss.progress_total = MAX_POINTER_DEPTH;
+
+	for (int level = 0; level < MAX_POINTER_DEPTH && !ss.cancelled; level++) {
+		spans.resize(0);
+		for (int i = 0; i < kept.size(); i++) {
+			if (kept[i].depth > level)
+				spans.push_back({ .address = addrs[i], .size = sizeof(u64), .tag = i });
 		}
-		else {
-			if (sv.size == 8)
-				single_value_search<METHOD_RANGE, std::uint8_t>(handle, *(std::uint8_t*)&sv.value1, *(std::uint8_t*)&sv.value2);
-			else if (sv.size == 16)
-				single_value_search<METHOD_RANGE, std::uint16_t>(handle, *(std::uint16_t*)&sv.value1, *(std::uint16_t*)&sv.value2);
-			else if (sv.size == 32)
-				single_value_search<METHOD_RANGE, std::uint32_t>(handle, *(std::uint32_t*)&sv.value1, *(std::uint32_t*)&sv.value2);
+		if (spans.size() == 0)
+			break;
+
+		values.resize(spans.size());
+		for (int i = 0; i < spans.size(); i++)
+			spans[i].data = (u8*)&values[i];
+
+		read_spans(handle, ss.search.source_type, ss.search.pid, spans.data(), spans.size());
+
+		for (int i = 0; i < spans.size(); i++) {
+			int k = spans[i].tag;
+			if (spans[i].retrieved == sizeof(u64))
+				addrs[k] = values[i] + (u64)kept[k].offsets[level];
 			else
-				single_value_search<METHOD_RANGE, std::uint64_t>(handle, *(std::uint64_t*)&sv.value1, *(std::uint64_t*)&sv.value2);
+				addrs[k] = ss.search.pointer_target + 1;
 		}
+
+		ss.progress_done = level + 1;
 	}
-}
 
-template<typename T>
-s64 roundtrip_cast(s64 in) {
-	T value = (T)in;
-	return (s64)value;
+	ss.paths.resize(0);
+	for (int i = 0; i < kept.size(); i++) {
+		if (addrs[i] == ss.search.pointer_target)
+			ss.paths.push_back(kept[i]);
+	}
 }
 
-s64 cast(u32 flags, int size, s64 in) {
-	s64 out = 0;
+void do_pointer_scan(Search_Session& ss, SOURCE_HANDLE handle) {
+	ss.snapshot.clear();
 
-	if (flags & FLAG_FLOAT) {
-		out = in;
-	}
-	else if (flags & FLAG_SIGNED) {
-		if (size == 8)
-			out = roundtrip_cast<std::int8_t>(in);
-		else if (size == 16)
-			out = roundtrip_cast<std::int16_t>(in);
-		else if (size == 32)
-			out = roundtrip_cast<std::int32_t>(in);
-		else if (size == 64)
-			out = roundtrip_cast<std::int64_t>(in);
-		else
-			out = in;
-	}
-	else {
-		if (size == 8)
-			out = roundtrip_cast<std::uint8_t>(in);
-		else if (size == 16)
-			out = roundtrip_cast<std::uint16_t>(in);
-		else if (size == 32)
-			out = roundtrip_cast<std::uint32_t>(in);
-		else if (size == 64)
-			out = roundtrip_cast<std::uint64_t>(in);
+	if (ss.results.total > 0 && ss.paths.size() > 0) {
+		std::vector<Pointer_Path> prev = ss.paths;
+		check_pointer_paths(ss, handle);
+
+		if (ss.cancelled)
+			ss.paths.swap(prev);
 		else
-			out = in;
+			set_pointer_results(ss);
+		return;
 	}
 
-	return out;
-}
+	ss.paths.resize(0);
+	ss.path_labels.resize(0);
+	if (ss.ranges.size() == 0)
+		return;
 
-// TODO: Support both endians, bitfields, arrays (including string literals)
-void do_object_search(SOURCE_HANDLE handle) {
-	int byte_inc = search.byte_align;
-	if (byte_inc <= 0)
-		byte_inc = search.record->total_size / 8;
+	ss.results.set_stride(1);
 
-	int n_params = search.n_params;
+	std::vector<std::vector<Pointer_Entry>> lists;
+	Parallel_Scan scan;
 
-	char *page_attrs_buf = new char[n_params * (2 * sizeof(s64) + sizeof(u64) + sizeof(int))]();
+	// the chunks aren't known until the scan has started, so there's room for as many as the ranges could possibly be split into
+	u64 total = 0;
+	for (auto& r : ss.ranges)
+		total += r.second / STREAM_MIN_BLOCK + 2;
+	lists.resize(total);
+	scan.extra = lists.data();
 
-	s64 *values      = reinterpret_cast<s64*>(page_attrs_buf);
-	u64 *page_addrs  = reinterpret_cast<u64*>(page_attrs_buf + n_params * 2 * sizeof(s64));
-	int *page_idxs   = reinterpret_cast<int*>(page_attrs_buf + n_params * (2 * sizeof(s64) + sizeof(u64)));
+	run_parallel_scan(ss, scan, pointer_scan_chunk);
+	if (ss.cancelled)
+		return;
 
-	char *page_mem = new char[(n_params + 1) * PAGE_SIZE];
+	lists.resize(scan.chunks.size());
+	merge_pointer_lists(lists);
 
-	// totally unnecessary but totally swag
-	char *pages = reinterpret_cast<char*>((reinterpret_cast<u64>(page_mem) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+	ss.progress_done = 0;
+	ss.progress_total = ss.search.max_depth;
 
-	for (int i = 0; i < n_params; i++) {
-		page_addrs[i] = -1;
+	if (lists.size() > 0)
+		find_pointer_paths(ss, lists[0]);
 
-		Search_Parameter& p = search.params[i];
-		values[i*2]   = cast(p.flags, p.size, p.value1);
-		values[i*2+1] = cast(p.flags, p.size, p.value2);
+	if (ss.cancelled) {
+		ss.paths.resize(0);
+		ss.results.clear();
+		return;
 	}
 
-	auto search_all_parameters = [&](u64 head_address) {
-		int matches = 0;
-
-		for (int j = 0; j < n_params; j++) {
-			u64 byte_offset = (u64)(search.params[j].offset / 8);
-			u64 addr = head_address + byte_offset;
-			u64 page = addr & ~(PAGE_SIZE - 1);
-			int page_offset = (int)(addr - page);
-
-			if (page != page_addrs[j]) {
-				int p = 0;
-				for (; p < n_params; p++) {
-					if (page_addrs[p] == page)
-						break;
-				}
-
-				if (p >= n_params) {
-					int retrieved = read_page(handle, search.source_type, page, &pages[j * PAGE_SIZE]);
-					if (retrieved <= 0)
-						return -1;
-
-					p = j;
-				}
-
-				page_addrs[j] = page;
-				page_idxs[j] = p;
-			}
-
-			char *buf = &pages[page_idxs[j] * PAGE_SIZE];
-			int byte_size = search.params[j].size / 8;
-
-			s64 value = 0;
-			for (int k = 0; k < byte_size; k++)
-				value |= (s64)(buf[page_offset + k] & 0xff) << (s64)(8*k);
+	set_pointer_results(ss);
+}
 
-			value = cast(search.params[j].flags, search.params[j].size, value);
+bool resolve_pointer_path(SOURCE_HANDLE handle, SourceType type, int pid, std::vector<Region> const& regions, const char *path, u64& address) {
+	const char *p = path;
+	while (*p == ' ')
+		p++;
 
-			if (
-				(search.params[j].method == METHOD_EQUALS && value == values[2*j]) || 
-				(search.params[j].method == METHOD_RANGE  && value >= values[2*j] && value <= values[2*j+1])
-			)
-				matches++;
+	int depth = 0;
+	while (*p == '[') {
+		depth++;
+		p++;
+	}
+	if (depth == 0 || depth > MAX_POINTER_DEPTH)
+		return false;
+
+	// module names can have a '+' in them (eg. libstdc++), so the base offset starts at the last '+' before a number
+	const char *name = p;
+	const char *name_end = p;
+	while (*p && *p != ']') {
+		if (*p == '+' && p[1] >= '0' && p[1] <= '9')
+			name_end = p;
+		p++;
+	}
+	if (name_end == name)
+		name_end = p;
+
+	p = name_end;
+	std::string base_name(name, name_end - name);
+	while (base_name.size() > 0 && base_name.back() == ' ')
+		base_name.pop_back();
+
+	// the base is either a module, where the lowest region with that name is where it was loaded, or just an address
+	char *end = nullptr;
+	u64 base = strtoull(base_name.c_str(), &end, 0);
+	if (base_name.size() == 0 || *end) {
+		base = 0;
+		for (auto& reg : regions) {
+			if (reg.name && base_name == get_base_name(reg.name) && (!base || reg.base < base))
+				base = reg.base;
 		}
+		if (!base)
+			return false;
+	}
 
-		return matches;
-	};
+	u64 addr = base;
+	if (*p == '+')
+		addr += strtoull(p + 1, (char**)&p, 0);
+
+	for (int i = 0; i < depth; i++) {
+		while (*p == ' ')
+			p++;
+		if (*p != ']')
+			return false;
+		p++;
+
+		u64 value = 0;
+		Span span = {
+			.data = (u8*)&value,
+			.address = addr,
+			.size = sizeof(u64)
+		};
+		read_spans(handle, type, pid, &span, 1);
+		if (span.retrieved != sizeof(u64))
+			return false;
+
+		addr = value;
+		while (*p == ' ')
+			p++;
+		if (*p == '+')
+			addr += strtoull(p + 1, (char**)&p, 0);
+		else if (*p == '-')
+			addr -= strtoull(p + 1, (char**)&p, 0);
+	}
 
-	if (n_results == 0) {
-		auto scan = isolate_scan_ranges();
+	address = addr;
+	return true;
+}
 
-		u64 head = scan.start;
-		for (int i = scan.first_range; i <= scan.last_range && head <= search.end_addr; i++) {
-			u64 range_end = ranges[i].first + ranges[i].second;
-			if (search.end_addr < range_end)
-				range_end = search.end_addr;
+// Finds the allocations that are live in the process right now, each as a range of addresses that can be read.
+// The bytes at the end of a chunk that's in use belong to it, even though they look like part of the next chunk.
+static bool find_live_allocations(Search_Session& ss, SOURCE_HANDLE handle, std::vector<std::pair<u64, u64>>& live) {
+	live.resize(0);
 
-			for (; head < range_end; head += byte_inc) {
-				int matches = search_all_parameters(head);
+	std::vector<Heap_Chunk> chunks;
+	if (!walk_glibc_heap(handle, ss.search.pid, ss.heap_areas, chunks))
+		return false;
 
-				if (matches == n_params) {
-					results[n_results++] = head;
-					if (n_results >= MAX_SEARCH_RESULTS)
-						goto done_object;
-				}
-			}
+	for (auto& c : chunks) {
+		if ((c.flags & HEAP_CHUNK_IN_USE) == 0)
+			continue;
 
-			if (i < scan.last_range)
-				head = ranges[i + 1].first;
-		}
+		u64 end = c.address + c.size + ((c.flags & HEAP_CHUNK_MMAPPED) ? 0 : sizeof(u64));
+		live.push_back(std::make_pair(c.address + HEAP_CHUNK_HEADER, end));
 	}
-	else {
-		n_prev_results = n_results;
-		if (!prev_results)
-			prev_results = new u64[MAX_SEARCH_RESULTS];
 
-		memcpy(prev_results, results, n_prev_results * sizeof(u64));
-		n_results = 0;
+	return true;
+}
 
-		for (int i = 0; i < n_prev_results; i++) {
-			u64 head = prev_results[i];
-			int matches = search_all_parameters(head);
+// Allocations that are close together are scanned as one range, since scanning lots of tiny ranges costs more than scanning the gaps between them
+static void get_live_scan_ranges(std::vector<std::pair<u64, u64>> const& live, std::vector<std::pair<u64, u64>>& ranges) {
+	ranges.resize(0);
+	for (auto& r : live) {
+		if (ranges.size() > 0 && r.first - (ranges.back().first + ranges.back().second) < PAGE_SIZE)
+			ranges.back().second = r.second - ranges.back().first;
+		else
+			ranges.push_back(std::make_pair(r.first, r.second - r.first));
+	}
+}
 
-			if (matches == n_params) {
-				results[n_results++] = head;
-				if (n_results >= MAX_SEARCH_RESULTS)
-					goto done_object;
-			}
+// Drops the results that landed in the gaps between allocations
+static void keep_live_results(Result_Set& set, std::vector<std::pair<u64, u64>> const& live) {
+	Result_Set kept;
+	kept.stride = set.stride;
+
+	u16 offsets[PAGE_SIZE];
+	int r = 0;
+	for (int i = 0; i < set.pages.size(); i++) {
+		u64 page = set.pages[i].address;
+		int n_offsets = set.get_offsets(i, offsets);
+
+		int n_kept = 0;
+		for (int j = 0; j < n_offsets; j++) {
+			u64 addr = page + offsets[j];
+			while (r < live.size() && live[r].second <= addr)
+				r++;
+
+			if (r < live.size() && addr >= live[r].first)
+				offsets[n_kept++] = offsets[j];
 		}
+
+		kept.add_page(page, offsets, n_kept);
 	}
 
-done_object:
-	delete[] page_attrs_buf;
-	delete[] page_mem;
+	std::swap(set, kept);
 }
 
 // We know the thread has ended if started == true and running == false
-void perform_search() {
-	started = true;
-	running = true;
+void perform_search(Search_Session& ss) {
+	SOURCE_HANDLE handle = open_search_handle(ss);
+	if (!handle) {
+		ss.running = false;
+		return;
+	}
 
-	if (!results)
-		results = new u64[MAX_SEARCH_RESULTS];
+	// refinements only look at the previous results, so it's only a first scan that needs to be narrowed down
+	bool live_only = ss.search.live_chunks_only && ss.search.source_type == SourceProcess && ss.search.max_depth == 0 && ss.results.total == 0;
 
-	auto handle = (SOURCE_HANDLE)0;
-	if (search.source_type == SourceFile)
-		handle = get_readonly_file_handle(search.identifier);
-	else if (search.source_type == SourceProcess)
-		handle = get_readonly_process_handle(search.pid);
+	std::vector<std::pair<u64, u64>> live;
+	std::vector<std::pair<u64, u64>> region_ranges;
+	std::vector<u8> region_priorities;
+	// without a heap to walk (eg. not glibc, or statically linked), there's nothing to narrow the scan down to, so it covers the regions like usual
+	if (live_only && !find_live_allocations(ss, handle, live)) {
+		sdl_log_string("Error: could not find a glibc heap in the process, so all of its memory will be searched instead");
+		live_only = false;
+	}
 
-	if (!handle) {
-		running = false;
-		return;
+	if (live_only) {
+		std::swap(ss.ranges, region_ranges);
+		std::swap(ss.range_priorities, region_priorities);
+		get_live_scan_ranges(live, ss.ranges);
 	}
 
-	if (!search.params)
-		do_single_value_search(handle);
+	if (ss.search.max_depth > 0)
+		do_pointer_scan(ss, handle);
+	else if (ss.search.group.n_values > 0)
+		do_group_search(ss, handle);
+	else if (ss.search.n_patterns > 0)
+		do_pattern_search(ss, handle);
+	else if (!ss.search.params)
+		do_single_value_search(ss, handle);
 	else
-		do_object_search(handle);
+		do_object_search(ss, handle);
+
+	if (live_only) {
+		std::swap(ss.ranges, region_ranges);
+		std::swap(ss.range_priorities, region_priorities);
+		if (!ss.cancelled) {
+			keep_live_results(ss.results, live);
+			keep_live_results(ss.alt_results, live);
+		}
+	}
+
+	// a cancelled pass puts back the snapshot from before it, but the soft-dirty bits might have been cleared since then
+	if (ss.cancelled)
+		ss.writes_tracked = false;
+
+	if (ss.file && !ss.cancelled && !ss.search.params && ss.search.n_patterns == 0 && ss.search.group.n_values == 0 && ss.search.max_depth == 0)
+		write_search_record(ss);
 
-	running = false;
+	close_readonly_handle(handle);
+	ss.running = false;
 }
@@ -1,10 +1,30 @@
 #pragma once
 
-#define MAX_SEARCH_RESULTS 10000
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+
+// The results table only shows this many rows, though a search can hold many more results than this
+#define MAX_DISPLAYED_RESULTS 100000
 #define MAX_SEARCH_PARAMS 100
 
-#define METHOD_EQUALS 0
-#define METHOD_RANGE  1
+#define METHOD_EQUALS     0
+#define METHOD_RANGE      1
+
+// These compare against a snapshot of what memory looked like after the previous pass, rather than a known value
+#define METHOD_UNKNOWN    2
+#define METHOD_CHANGED    3
+#define METHOD_UNCHANGED  4
+#define METHOD_INCREASED  5
+#define METHOD_DECREASED  6
+#define METHOD_CHANGED_BY 7
+
+// These let through a band of values around value1, which is what's needed for floats that are only ever seen rounded.
+// 'Within' uses value2 as the largest difference allowed, while 'rounds to' and 'truncates to' use it as the place value
+//  of the last digit shown (eg. 0.1 for 97.3). An integer already is its own rounded value, so those two act like equals for them.
+#define METHOD_NEAR         8
+#define METHOD_ROUNDS_TO    9
+#define METHOD_TRUNCATES_TO 10
 
 struct Search_Parameter {
 	u32 flags;
@@ -15,24 +35,290 @@ struct Search_Parameter {
 	s64 value2;
 };
 
+#define MAX_PATTERN_BYTES 256
+
+// A text search looks for the same string in more than one encoding at a time
+#define MAX_SEARCH_PATTERNS 2
+
+// A sequence of bytes to look for. A byte in memory matches when (byte & mask[i]) == bytes[i],
+//  so a mask of 0 makes a byte a wildcard and a mask of 0x0f or 0xf0 only checks one nibble.
+struct Byte_Pattern {
+	u8 bytes[MAX_PATTERN_BYTES];
+	u8 mask[MAX_PATTERN_BYTES];
+	int size = 0;
+
+	// the two positions least likely to match by chance, which are compared first across a whole vector of starting points
+	int anchors[2];
+
+	const char *label = nullptr; // shown next to each result that this pattern found
+};
+
+// Parses a string like "48 8B ?? ?? 00 00 E8". '?' or '??' is a whole wildcard byte, while "4?" or "?B" only checks one nibble.
+// Returns false if the string is empty, malformed, too long or entirely made of wildcards.
+bool parse_byte_pattern(const char *str, Byte_Pattern& pattern);
+
+#define TEXT_ANY      0
+#define TEXT_UTF8     1
+#define TEXT_UTF16LE  2
+
+// Turns a UTF-8 string into a pattern for each encoding it should be looked for in, returning how many there are (0 if the string is invalid).
+// Ignoring case folds ASCII letters, as well as the Latin-1 letters from U+00C0 to U+00DE, which differ from their lowercase forms by one bit in both encodings.
+int make_text_patterns(const char *str, int encoding, bool ignore_case, Byte_Pattern *patterns);
+
+#define MAX_GROUP_VALUES  8
+#define MAX_GROUP_WINDOW  4096
+
+// A few values that have to be found close together, without needing a struct to say where each one is.
+// A group starts wherever one of its values is, as long as every value can be found in the 'window' bytes from there, with no two values sharing a byte.
+// If it's ordered, the group has to start with the first value, and each of the others has to come after the one before it.
+struct Value_Group {
+	Byte_Pattern values[MAX_GROUP_VALUES]; // the bytes that each value is stored as
+	int n_values = 0;
+	int window = 0;
+	bool ordered = false;
+
+	// the value least likely to turn up by chance, which is the only one that first scans look for across the whole chunk
+	int anchor = 0;
+
+	// the order that an unordered group's values get placed in, rarest first, with identical values next to each other
+	int order[MAX_GROUP_VALUES];
+	bool same_as_prev[MAX_GROUP_VALUES]; // whether values[order[i]] is identical to values[order[i-1]]
+};
+
+// Turns typed values (as in Search::single_value) into a group, returning false if there are too many or any of them has a size that values can't be.
+bool make_value_group(const Search_Parameter *values, int n_values, int window, bool ordered, Value_Group& group);
+
+// Pointer scans follow chains of up to this many pointers back from the target
+#define MAX_POINTER_DEPTH 8
+#define MAX_POINTER_PATHS MAX_DISPLAYED_RESULTS
+
 struct Search {
 	Search_Parameter single_value = {0};
+	Byte_Pattern patterns[MAX_SEARCH_PATTERNS];
+	int n_patterns = 0;
 	Search_Parameter *params = nullptr;
 	int n_params = 0;
+	Value_Group group;
 
 	int byte_align = 0;
+	bool resident_only = false; // skip pages of a process that have never been touched
+	bool track_writes = false; // only re-read pages of a process that it has written to since the last snapshot
+	bool live_chunks_only = false; // only scan the parts of a process's glibc heaps that are currently allocated
 	u64 start_addr = 0;
 	u64 end_addr = 0;
 	Struct *record = nullptr;
 
+	// A pointer scan is any search with a max_depth. Each pointer in a path can point up to max_offset bytes before the next one.
+	u64 pointer_target = 0;
+	int max_depth = 0;
+	int max_offset = 0;
+
 	SourceType source_type = SourceNone;
 	int pid = 0;
 	void *identifier = nullptr;
 };
 
-void start_search(Search& s, std::vector<Region> const& regions);
-bool check_search_running();
-bool check_search_finished();
-void get_search_results(std::vector<u64>& results_vec);
-void reset_search();
+#define RESULTS_ALL     0
+#define RESULTS_LIST    1
+#define RESULTS_BITMAP  2
+
+struct Result_Page {
+	u64 address;
+	u64 index;    // number of results in all the pages before this one
+	u32 data;     // position in Result_Set::pool, in units of u64
+	u16 count;
+	u16 encoding;
+};
+
+// A sorted set of addresses, grouped by page.
+// Each page stores its offsets in whichever encoding is smallest: nothing at all if every slot in the page matched,
+//  a list of 16-bit offsets, or a bitmap with one bit per slot. A slot is 'stride' bytes wide.
+struct Result_Set {
+	std::vector<Result_Page> pages;
+	std::vector<u64> pool;
+	u64 total = 0;
+	int stride = 1;
+
+	void clear();
+	void set_stride(int align);
+
+	// Pages must be added in ascending order, and offsets within a page must be ascending
+	void add_page(u64 address, const u16 *offsets, int count);
+	void append(Result_Set& other);
+
+	int get_offsets(int page_idx, u16 *offsets) const;
+	u64 at(u64 idx) const;
+	u64 memory_size() const;
+
+	// Writes the set in a form that load() can read straight back out of memory, returning how many bytes that took (0 if writing failed)
+	u64 save(FILE *f) const;
+	// Returns how many of the 'size' bytes at 'data' were used, or 0 if they don't hold a valid set
+	u64 load(const u8 *data, u64 size);
+};
+
+#define COMBINE_INTERSECT   0
+#define COMBINE_UNION       1
+#define COMBINE_DIFFERENCE  2
+#define COMBINE_WITHIN      3
+
+// Combines two sets in a single pass over both of them, writing the result into 'out', which can't be either of the two.
+// COMBINE_WITHIN keeps the addresses in 'a' that are no more than 'distance' bytes away from some address in 'b'.
+void combine_result_sets(const Result_Set& a, const Result_Set& b, int op, u64 distance, Result_Set& out);
+
+#define SNAPSHOT_ZERO        0xffffffff
+#define SNAPSHOT_SLAB_PAGES  256
+
+struct Snapshot_Page {
+	u64 address;
+	u32 block; // index of the stored copy, or SNAPSHOT_ZERO if the page was all zeroes
+};
+
+// Copies of the pages a pass looked at, so that the next pass can compare what's there now with what was there then.
+// Pages that are entirely zero aren't stored at all, and pages with identical contents share one copy.
+// Blocks may be stored from several threads at once, but 'pages' is only ever touched by one thread at a time.
+// Blocks can also be read while others are being stored, as long as there's been a reserve() for every block that gets stored.
+struct Snapshot {
+	std::vector<Snapshot_Page> pages;
+	std::vector<u8*> slabs;
+	std::unordered_map<u64, u32> hashes;
+	u32 n_blocks = 0;
+	std::mutex lock;
+
+	~Snapshot() {
+		clear();
+	}
+
+	void clear();
+	void swap(Snapshot& other);
+	void reserve(u32 n_more_blocks);
+
+	u32 store(const u8 *page);
+	const u8 *get_block(u32 block) const;
+
+	// Returns the index of the page at 'address', or -1. Pages before 'from' aren't looked at.
+	int find(u64 address, int from) const;
+	u64 memory_size() const;
+
+	// Like Result_Set::save() and load(). Only the blocks that a page still uses are saved.
+	u64 save(FILE *f) const;
+	u64 load(const u8 *data, u64 size);
+
+	// Takes a copy of each page in 'other' that isn't in this snapshot already
+	void merge(const Snapshot& other);
+};
+
+struct Search_Progress {
+	u64 done;
+	u64 total;
+	u64 matches;
+};
+
+// Holds the results of one search between passes. Sessions are independent, so several searches can run at once.
+struct Search_Session;
+
+Search_Session *open_search_session();
+void close_search_session(Search_Session *session);
+
+void start_search(Search_Session& session, Search& s, std::vector<Region> const& regions);
+bool check_search_running(Search_Session& session);
+bool check_search_finished(Search_Session& session);
+void get_search_results(Search_Session& session, std::vector<u64>& results_vec);
+void get_search_result_labels(Search_Session& session, std::vector<char*>& labels);
+u64 get_search_result_count(Search_Session& session);
+void get_search_progress(Search_Session& session, Search_Progress& progress);
+
+// Pops up to 'max' of the results found so far in the current pass, in address order.
+// Only the first MAX_DISPLAYED_RESULTS of each pass come through here. Should only be called from one thread.
+int take_partial_results(Search_Session& session, u64 *out, int max);
+
+// A cancelled first scan leaves no results behind, while a cancelled refinement leaves the results from before it
+void cancel_search(Search_Session& session);
+// Does nothing while a search is running, since the search thread is still using the results
+void reset_search(Search_Session& session);
+
+// Replaces the results of 'session' with some combination of them and the results of 'other' (see combine_result_sets()), without searching again.
+// Returns false if either session is in the middle of a search.
+bool combine_search_results(Search_Session& session, Search_Session& other, int op, u64 distance);
+
+// Closes every session that's still open
 void exit_search();
+
+// Works out where a pointer path such as "[[libgame.so+0x1a2b0]+0x18]+0x40" leads to right now.
+// The base can be the name of a module in 'regions' or an address. Returns false if the text isn't a path, or a pointer along it can't be read.
+bool resolve_pointer_path(SOURCE_HANDLE handle, SourceType type, int pid, std::vector<Region> const& regions, const char *path, u64& address);
+
+#define SEARCH_FILE_NAME_LEN 256
+#define SEARCH_FILE_TYPE_LEN 64
+
+// A session can keep its results in a file, so that a search can be carried on with after Muscles has been closed.
+// Each value search pass that finishes gets a record appended to the file, holding what it searched for, its results, and the snapshot if there is one.
+// Every record is complete by itself, so a crash partway through a pass only loses that pass, and the records together are the history of the search.
+struct Search_File_Info {
+	SourceType source_type;
+	int pid;
+	char source_name[SEARCH_FILE_NAME_LEN]; // the name of the process, or the path of the file
+	char type_name[SEARCH_FILE_TYPE_LEN];
+
+	int byte_align;
+	u64 start_addr;
+	u64 end_addr;
+	std::vector<Search_Parameter> history; // one for each pass, oldest first
+};
+
+// Creates (or overwrites) the file at 'path', which every pass from now on gets appended to.
+// 'source_name' and 'type_name' are only kept so that the search can be set up the same way again.
+bool attach_search_file(Search_Session& session, const char *path, SourceType source_type, int pid, const char *source_name, const char *type_name);
+void detach_search_file(Search_Session& session);
+
+// Puts back the results and snapshot from the latest pass in a search file, then carries on appending to it.
+// The file is mapped rather than read. Returns false if it isn't a search file, or if the session is in the middle of a search.
+bool resume_search_file(Search_Session& session, const char *path, Search_File_Info& info);
+
+// Finds every aligned word in a process whose value is in [start, end), putting how many there are in 'total'.
+// Up to 'max' of their addresses go into 'addresses', in address order.
+// The first call starts indexing every pointer in the process by where it points in the background, and returns false until that's done.
+// update_pointer_index() then keeps the index up to date a few blocks each tick.
+bool find_pointers_to(Source& source, u64 start, u64 end, std::vector<u64>& addresses, int max, u64& total);
+void update_pointer_index(Source& source);
+void close_pointer_index(Source& source);
+
+#define HEAP_AREA_BRK   0 // the [heap] region, where main_arena's chunks are
+#define HEAP_AREA_LIBC  1 // glibc's writable data, where main_arena itself is
+#define HEAP_AREA_ANON  2 // anonymous mappings, where the other arenas' heaps and mmapped chunks are
+
+struct Heap_Area {
+	u64 base;
+	u64 size;
+	int type;
+};
+
+#define HEAP_CHUNK_IN_USE   1
+#define HEAP_CHUNK_MMAPPED  2
+
+// The allocation that malloc() returned is 16 bytes past the start of its chunk
+#define HEAP_CHUNK_HEADER 16
+
+struct Heap_Chunk {
+	u64 address; // of the chunk, not the allocation
+	u64 size;
+	u32 flags;
+};
+
+void find_heap_areas(std::vector<Region> const& regions, std::vector<Heap_Area>& areas);
+
+// Walks every chunk of every glibc malloc arena in a process, starting from main_arena, plus any chunks that were mmapped by themselves.
+// Chunks that are sitting in a tcache or a fastbin are counted as free, even though the chunk after them still says they're in use.
+// The chunks come out sorted by address. Returns false if no heap could be found.
+bool walk_glibc_heap(SOURCE_HANDLE handle, int pid, std::vector<Heap_Area> const& areas, std::vector<Heap_Chunk>& chunks);
+
+// The chunk that 'address' is in, or nullptr if it's not in any of them
+const Heap_Chunk *find_heap_chunk(std::vector<Heap_Chunk> const& chunks, u64 address);
+
+// How often a source's heap gets walked again, in ticks of the source's timer
+#define HEAP_WALK_TICKS 60
+
+// Like find_heap_chunk(), using the chunks from the last time the source's heap was walked, or nullptr until the first walk is done.
+// The heap is walked in the background, which the first call starts, and update_heap_cache() then does again every HEAP_WALK_TICKS.
+const Heap_Chunk *find_source_heap_chunk(Source& source, u64 address);
+void update_heap_cache(Source& source);
+void close_heap_cache(Source& source);
@@ -0,0 +1,202 @@
+#include "muscles.h"
+#include "structs.h"
+#include "search.h"
+
+#include <algorithm>
+
+static const u8 zero_page[PAGE_SIZE] = {0};
+
+void Snapshot::clear() {
+	for (auto& s : slabs)
+		delete[] s;
+
+	pages.resize(0);
+	slabs.resize(0);
+	hashes.clear();
+	n_blocks = 0;
+}
+
+void Snapshot::swap(Snapshot& other) {
+	std::swap(pages, other.pages);
+	std::swap(slabs, other.slabs);
+	std::swap(hashes, other.hashes);
+	std::swap(n_blocks, other.n_blocks);
+}
+
+// Makes sure 'slabs' won't need to grow while storing up to n_more_blocks blocks, since that would move it under anyone reading a block
+void Snapshot::reserve(u32 n_more_blocks) {
+	u32 n_slabs = (n_blocks + n_more_blocks + SNAPSHOT_SLAB_PAGES - 1) / SNAPSHOT_SLAB_PAGES;
+	slabs.reserve(n_slabs);
+}
+
+u32 Snapshot::store(const u8 *page) {
+	// four separate lanes keep the multiplies from waiting on each other
+	const u64 *words = (const u64*)page;
+	u64 h[4] = {0xcbf29ce484222325, 0x84222325cbf29ce4, 0x9e3779b97f4a7c15, 0x7f4a7c159e3779b9};
+	u64 bits = 0;
+
+	for (int i = 0; i < PAGE_SIZE / sizeof(u64); i += 4) {
+		for (int j = 0; j < 4; j++) {
+			bits |= words[i+j];
+			h[j] = (h[j] ^ words[i+j]) * 0x100000001b3;
+		}
+	}
+
+	if (bits == 0)
+		return SNAPSHOT_ZERO;
+
+	u64 hash = h[0] ^ (h[1] >> 17) ^ (h[2] << 23) ^ (h[3] >> 31);
+
+	std::lock_guard<std::mutex> guard(lock);
+
+	auto it = hashes.find(hash);
+	if (it != hashes.end() && memcmp(get_block(it->second), page, PAGE_SIZE) == 0)
+		return it->second;
+
+	u32 block = n_blocks++;
+	if (block / SNAPSHOT_SLAB_PAGES >= slabs.size())
+		slabs.push_back(new u8[SNAPSHOT_SLAB_PAGES * PAGE_SIZE]);
+
+	memcpy((u8*)get_block(block), page, PAGE_SIZE);
+
+	// on the off chance that two different pages have the same hash, the second one just doesn't get shared
+	if (it == hashes.end())
+		hashes[hash] = block;
+
+	return block;
+}
+
+const u8 *Snapshot::get_block(u32 block) const {
+	if (block == SNAPSHOT_ZERO)
+		return zero_page;
+
+	return &slabs[block / SNAPSHOT_SLAB_PAGES][(block % SNAPSHOT_SLAB_PAGES) * PAGE_SIZE];
+}
+
+int Snapshot::find(u64 address, int from) const {
+	if (from < 0)
+		from = 0;
+	if (from >= pages.size())
+		return -1;
+
+	auto it = std::lower_bound(pages.begin() + from, pages.end(), address, [](const Snapshot_Page& p, u64 addr) {
+		return p.address < addr;
+	});
+
+	if (it == pages.end() || it->address != address)
+		return -1;
+
+	return it - pages.begin();
+}
+
+u64 Snapshot::memory_size() const {
+	return pages.size() * sizeof(Snapshot_Page) + slabs.size() * SNAPSHOT_SLAB_PAGES * PAGE_SIZE + hashes.size() * 2 * sizeof(u64);
+}
+
+struct Snapshot_Header {
+	u64 n_pages;
+	u64 n_blocks;
+};
+
+struct Saved_Snapshot_Page {
+	u64 address;
+	u32 block;
+	u32 reserved;
+};
+
+u64 Snapshot::save(FILE *f) const {
+	// blocks are numbered again in the order they're saved in, leaving out any that no page uses anymore
+	std::vector<u32> renumbered(n_blocks, SNAPSHOT_ZERO);
+	std::vector<u32> used;
+
+	for (auto& p : pages) {
+		if (p.block != SNAPSHOT_ZERO && renumbered[p.block] == SNAPSHOT_ZERO) {
+			renumbered[p.block] = used.size();
+			used.push_back(p.block);
+		}
+	}
+
+	Snapshot_Header header = {
+		.n_pages = pages.size(),
+		.n_blocks = used.size()
+	};
+	if (fwrite(&header, sizeof(header), 1, f) != 1)
+		return 0;
+
+	for (auto& p : pages) {
+		Saved_Snapshot_Page saved = {
+			.address = p.address,
+			.block = p.block == SNAPSHOT_ZERO ? SNAPSHOT_ZERO : renumbered[p.block],
+			.reserved = 0
+		};
+		if (fwrite(&saved, sizeof(saved), 1, f) != 1)
+			return 0;
+	}
+
+	for (u32 b : used) {
+		if (fwrite(get_block(b), PAGE_SIZE, 1, f) != 1)
+			return 0;
+	}
+
+	return sizeof(header) + pages.size() * sizeof(Saved_Snapshot_Page) + used.size() * PAGE_SIZE;
+}
+
+u64 Snapshot::load(const u8 *data, u64 size) {
+	clear();
+
+	Snapshot_Header header;
+	if (size < sizeof(header))
+		return 0;
+
+	memcpy(&header, data, sizeof(header));
+	if (header.n_pages > size / sizeof(Saved_Snapshot_Page) || header.n_blocks > size / PAGE_SIZE)
+		return 0;
+
+	u64 used = sizeof(header) + header.n_pages * sizeof(Saved_Snapshot_Page) + header.n_blocks * PAGE_SIZE;
+	if (used > size)
+		return 0;
+
+	const Saved_Snapshot_Page *saved = (const Saved_Snapshot_Page*)&data[sizeof(header)];
+	const u8 *blocks = (const u8*)&saved[header.n_pages];
+
+	// storing each block again also puts back the hashes that identical pages get shared through
+	std::vector<u32> renumbered(header.n_blocks);
+	for (u64 i = 0; i < header.n_blocks; i++)
+		renumbered[i] = store(&blocks[i * PAGE_SIZE]);
+
+	pages.resize(header.n_pages);
+	for (u64 i = 0; i < header.n_pages; i++) {
+		u32 block = saved[i].block;
+		if (block != SNAPSHOT_ZERO && block >= header.n_blocks) {
+			clear();
+			return 0;
+		}
+
+		pages[i] = {saved[i].address, block == SNAPSHOT_ZERO ? SNAPSHOT_ZERO : renumbered[block]};
+	}
+
+	return used;
+}
+
+void Snapshot::merge(const Snapshot& other) {
+	std::vector<Snapshot_Page> merged;
+	merged.reserve(pages.size() + other.pages.size());
+
+	int i = 0;
+	for (auto& p : other.pages) {
+		while (i < pages.size() && pages[i].address < p.address)
+			merged.push_back(pages[i++]);
+
+		if (i < pages.size() && pages[i].address == p.address)
+			continue;
+
+		Snapshot_Page page = {
+			.address = p.address,
+			.block = p.block == SNAPSHOT_ZERO ? SNAPSHOT_ZERO : store(other.get_block(p.block))
+		};
+		merged.push_back(page);
+	}
+
+	merged.insert(merged.end(), pages.begin() + i, pages.end());
+	pages.swap(merged);
+}
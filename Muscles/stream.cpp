@@ -0,0 +1,257 @@
+#include "muscles.h"
+#include "stream.h"
+
+bool Stream_Block::has_range(u64 addr, int len) const {
+	if (addr < address || addr + len > address + size)
+		return false;
+
+	int first = (int)((addr - address) / PAGE_SIZE);
+	int last = (int)((addr + len - 1 - address) / PAGE_SIZE);
+	for (int i = first; i <= last; i++) {
+		if (pages[i].retrieved <= 0)
+			return false;
+	}
+
+	return true;
+}
+
+// Reads just the pages that the page map says are worth reading, returning false if the page map couldn't be read
+static bool read_resident_block(Read_Stream& rs, Stream_Block& block) {
+	u8 *states = rs.page_states;
+	if (!read_page_states(rs.page_map, block.address, block.n_pages, states))
+		return false;
+
+	int n_resident = 0;
+	for (int i = 0; i < block.n_pages; i++) {
+		Span& p = block.pages[i];
+		p.data = (u8*)&block.data[i * PAGE_SIZE];
+		p.address = block.address + (u64)i * PAGE_SIZE;
+		p.size = PAGE_SIZE;
+		p.retrieved = 0;
+
+		if (states[i] == PAGE_ZERO) {
+			memset(p.data, 0, PAGE_SIZE);
+			p.retrieved = PAGE_SIZE;
+		}
+		else if (states[i] == PAGE_PRESENT) {
+			p.tag = i;
+			rs.resident[n_resident++] = p;
+		}
+	}
+
+	read_spans(rs.handle, rs.type, rs.pid, rs.resident, n_resident);
+
+	for (int i = 0; i < n_resident; i++) {
+		Span& p = block.pages[rs.resident[i].tag];
+		p.retrieved = rs.resident[i].retrieved;
+		if (p.retrieved > 0 && p.retrieved < PAGE_SIZE)
+			memset(&p.data[p.retrieved], 0, PAGE_SIZE - p.retrieved);
+	}
+
+	return true;
+}
+
+// Points the block at a view of the file instead of reading it. Pages past the end of the file are left out of the view,
+//  and a page that's only partly inside it is filled out with zeroes by the OS.
+static bool map_block(Read_Stream& rs, Stream_Block& block) {
+	if (block.view) {
+		unmap_file_view(block.view, block.view_size);
+		block.view = nullptr;
+		block.view_size = 0;
+	}
+
+	u64 end = block.address + block.size;
+	if (end > rs.file_size)
+		end = rs.file_size;
+
+	u64 view_size = end > block.address ? end - block.address : 0;
+	if (view_size > 0) {
+		block.view = (char*)map_file_view(rs.handle, block.address, view_size);
+		if (!block.view)
+			return false;
+
+		block.view_size = view_size;
+	}
+
+	block.data = block.view;
+
+	for (int i = 0; i < block.n_pages; i++) {
+		Span& p = block.pages[i];
+		u64 offset = (u64)i * PAGE_SIZE;
+
+		p.data = offset < view_size ? (u8*)&block.data[offset] : nullptr;
+		p.address = block.address + offset;
+		p.size = PAGE_SIZE;
+		p.retrieved = 0;
+		if (offset < view_size)
+			p.retrieved = view_size - offset < PAGE_SIZE ? (int)(view_size - offset) : PAGE_SIZE;
+	}
+
+	return true;
+}
+
+static void read_block(Read_Stream& rs, Stream_Block& block) {
+	block.n_pages = block.size / PAGE_SIZE;
+
+	if (rs.file_size > 0) {
+		if (map_block(rs, block))
+			return;
+
+		// the file can't be mapped (eg. it's a device), so it'll have to be read after all
+		if (!block.buffer)
+			block.buffer = new char[rs.capacity];
+	}
+
+	block.data = block.buffer;
+
+	if (rs.page_map && read_resident_block(rs, block))
+		return;
+
+	Span whole;
+	whole.data = (u8*)block.data;
+	whole.address = block.address;
+	whole.size = block.size;
+	read_spans(rs.handle, rs.type, rs.pid, &whole, 1);
+
+	int n_good = whole.retrieved > 0 ? whole.retrieved / PAGE_SIZE : 0;
+	for (int i = 0; i < block.n_pages; i++) {
+		Span& p = block.pages[i];
+		p.data = (u8*)&block.data[i * PAGE_SIZE];
+		p.address = block.address + (u64)i * PAGE_SIZE;
+		p.size = PAGE_SIZE;
+		p.retrieved = i < n_good ? PAGE_SIZE : 0;
+	}
+
+	if (n_good >= block.n_pages)
+		return;
+
+	read_spans(rs.handle, rs.type, rs.pid, &block.pages[n_good], block.n_pages - n_good);
+
+	// whatever's left over in a page that was only partly read (eg. at the end of a file) shouldn't be stale data from the last block
+	for (int i = n_good; i < block.n_pages; i++) {
+		Span& p = block.pages[i];
+		if (p.retrieved > 0 && p.retrieved < PAGE_SIZE)
+			memset(&p.data[p.retrieved], 0, PAGE_SIZE - p.retrieved);
+	}
+}
+
+static THREAD_RETURN_TYPE stream_thread(void *data) {
+	auto rs = (Read_Stream*)data;
+	std::unique_lock<std::mutex> guard(rs->lock);
+
+	while (true) {
+		rs->cond.wait(guard, [rs]() { return rs->quit || rs->state == STREAM_READING; });
+		if (rs->quit)
+			break;
+
+		// 'current' doesn't change while a block is being read
+		guard.unlock();
+		read_block(*rs, rs->blocks[rs->current ^ 1]);
+		guard.lock();
+
+		rs->state = STREAM_READY;
+		rs->cond.notify_all();
+	}
+
+	return (THREAD_RETURN_TYPE)0;
+}
+
+void Read_Stream::open(SOURCE_HANDLE handle, SourceType type, int pid, int capacity, SOURCE_HANDLE page_map) {
+	this->handle = handle;
+	this->type = type;
+	this->pid = pid;
+	this->capacity = capacity;
+	this->page_map = page_map;
+
+	this->file_size = type == SourceFile ? get_file_size(handle) : 0;
+
+	if (page_map) {
+		page_states = new u8[capacity / PAGE_SIZE];
+		resident = new Span[capacity / PAGE_SIZE];
+	}
+
+	// mapped blocks only get a buffer if mapping fails
+	for (auto& b : blocks) {
+		b.buffer = file_size > 0 ? nullptr : new char[capacity];
+		b.data = b.buffer;
+		b.pages = new Span[capacity / PAGE_SIZE];
+		b.address = 0;
+		b.size = 0;
+	}
+
+	current = 0;
+	state = STREAM_IDLE;
+	quit = false;
+
+	// without a helper thread, every block just gets read when it's asked for
+	if (!start_thread(&thread, this, stream_thread))
+		thread = nullptr;
+}
+
+void Read_Stream::close() {
+	if (thread) {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			quit = true;
+		}
+		cond.notify_all();
+		join_thread(thread);
+		thread = nullptr;
+	}
+
+	for (auto& b : blocks) {
+		unmap_file_view(b.view, b.view_size);
+		delete[] b.buffer;
+		delete[] b.pages;
+		b.data = nullptr;
+		b.buffer = nullptr;
+		b.view = nullptr;
+		b.view_size = 0;
+		b.pages = nullptr;
+	}
+
+	if (page_map) {
+		close_readonly_handle(page_map);
+		page_map = (SOURCE_HANDLE)0;
+	}
+
+	delete[] page_states;
+	delete[] resident;
+	page_states = nullptr;
+	resident = nullptr;
+}
+
+void Read_Stream::prefetch(u64 address, int size) {
+	if (!thread || size > capacity)
+		return;
+
+	std::unique_lock<std::mutex> guard(lock);
+	cond.wait(guard, [this]() { return state != STREAM_READING; });
+
+	Stream_Block& spare = blocks[current ^ 1];
+	spare.address = address;
+	spare.size = size;
+	state = STREAM_READING;
+
+	guard.unlock();
+	cond.notify_all();
+}
+
+const Stream_Block& Read_Stream::get(u64 address, int size) {
+	std::unique_lock<std::mutex> guard(lock);
+	cond.wait(guard, [this]() { return state != STREAM_READING; });
+
+	Stream_Block& spare = blocks[current ^ 1];
+	bool prefetched = state == STREAM_READY && spare.address == address && spare.size == size;
+	state = STREAM_IDLE;
+	guard.unlock();
+
+	if (!prefetched) {
+		spare.address = address;
+		spare.size = size;
+		read_block(*this, spare);
+	}
+
+	current ^= 1;
+	return blocks[current];
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+
+#define STREAM_MIN_BLOCK (1024 * 1024)
+#define STREAM_MAX_BLOCK (16 * 1024 * 1024)
+
+struct Stream_Block {
+	u64 address = 0;
+	int size = 0;
+	char *data = nullptr; // either 'buffer' or 'view'
+
+	char *buffer = nullptr;
+	char *view = nullptr;
+	u64 view_size = 0;
+
+	// one span per page. Pages that couldn't be read have 'retrieved' <= 0
+	Span *pages = nullptr;
+	int n_pages = 0;
+
+	// Whether every byte in [addr, addr + len) is inside this block and could be read
+	bool has_range(u64 addr, int len) const;
+};
+
+#define STREAM_IDLE     0
+#define STREAM_READING  1
+#define STREAM_READY    2
+
+// Reads a source a block at a time, fetching the next block on a helper thread while the current one is being scanned.
+// Each block is first read in one go, and if that comes up short, the rest of it is read a page at a time,
+//  so that an unreadable guard page doesn't take the rest of the block down with it.
+// With a page map, only the pages that are resident get read. Absent pages come back unread and zero pages are filled in directly.
+// Files are mapped a block at a time instead of being read, so that they're scanned straight out of the page cache.
+struct Read_Stream {
+	SOURCE_HANDLE handle = (SOURCE_HANDLE)0;
+	SourceType type = SourceNone;
+	int pid = 0;
+	int capacity = 0;
+
+	u64 file_size = 0; // 0 if this isn't a file that can be mapped
+
+	SOURCE_HANDLE page_map = (SOURCE_HANDLE)0; // owned by the stream
+	u8 *page_states = nullptr;
+	Span *resident = nullptr;
+
+	Stream_Block blocks[2];
+	int current = 0;
+
+	void *thread = nullptr;
+	std::mutex lock;
+	std::condition_variable cond;
+	int state = STREAM_IDLE;
+	bool quit = false;
+
+	// 'capacity' is the largest block that will be asked for, in bytes. 'page_map' is from get_page_map_handle(), or 0.
+	void open(SOURCE_HANDLE handle, SourceType type, int pid, int capacity, SOURCE_HANDLE page_map = (SOURCE_HANDLE)0);
+	void close();
+
+	// Starts reading [address, address + size) into the spare block
+	void prefetch(u64 address, int size);
+
+	// Returns the block for [address, address + size), which has already been read if it was the last one prefetched.
+	// 'address' and 'size' must be page-aligned. The block stays valid until the next call to get().
+	const Stream_Block& get(u64 address, int size);
+};
@@ -1,6 +1,7 @@
 #include <string>
 #include <vector>
 #include <cstring>
+#include <cmath>
 
 #include "containers.h"
 #include "structs.h"
@@ -106,6 +107,22 @@ Value64 evaluate_number(const char *token, bool as_float) {
 	return value;
 }
 
+double get_decimal_step(const char *token) {
+	const char *p = token;
+	while (*p && *p != '.' && *p != 'e' && *p != 'E')
+		p++;
+
+	int decimals = 0;
+	if (*p == '.') {
+		for (p++; *p >= '0' && *p <= '9'; p++)
+			decimals++;
+	}
+	if (*p == 'e' || *p == 'E')
+		decimals -= atoi(p + 1);
+
+	return pow(10.0, -decimals);
+}
+
 /*
    This method gets the full name of a field in a struct instance, eg. player.position.x.
    It retrieves names starting with the target field and working back up the hierarchy (eg. x, position, player)
@@ -83,6 +83,9 @@ struct Struct {
 bool is_struct_usable(Struct *s);
 void set_primitives(Map& definitions);
 Value64 evaluate_number(const char *token, bool as_float = false);
+
+// Returns the place value of the last digit in a decimal number, eg. 0.01 for "97.35" or 1 for "97"
+double get_decimal_step(const char *token);
 int get_full_field_name(Field& field, String_Vector& name_vector, String_Vector& out_vec);
 
 void tokenize(String_Vector& tokens, const char *text, int sz);
@@ -0,0 +1,157 @@
+#include "muscles.h"
+#include "thread-pool.h"
+
+#include <memory>
+
+void Task_Queue::assign(int first, int last) {
+	bounds = ((u64)last << 32ULL) | (u64)first;
+}
+
+bool Task_Queue::pop(int& task) {
+	u64 b = bounds.load();
+	while (true) {
+		int next = (int)(b & 0xffffffff);
+		int end = (int)(b >> 32ULL);
+		if (next >= end)
+			return false;
+
+		u64 b_new = ((u64)end << 32ULL) | (u64)(next + 1);
+		if (bounds.compare_exchange_weak(b, b_new)) {
+			task = next;
+			return true;
+		}
+	}
+}
+
+bool Task_Queue::steal(int& task) {
+	u64 b = bounds.load();
+	while (true) {
+		int next = (int)(b & 0xffffffff);
+		int end = (int)(b >> 32ULL);
+		if (next >= end)
+			return false;
+
+		u64 b_new = ((u64)(end - 1) << 32ULL) | (u64)next;
+		if (bounds.compare_exchange_weak(b, b_new)) {
+			task = end - 1;
+			return true;
+		}
+	}
+}
+
+int get_worker_count() {
+	int n = get_cpu_count();
+	if (n < 1)
+		n = 1;
+	if (n > MAX_WORKERS)
+		n = MAX_WORKERS;
+
+	return n;
+}
+
+// How many threads are working through tasks right now, across every call to run_tasks().
+// Jobs that run at the same time (eg. several searches) share get_worker_count() threads between them,
+//  rather than each one starting a full set and fighting over the cores.
+static std::atomic<int> workers_in_use = {0};
+
+// Takes up to 'wanted' workers from what's left of the budget, but always at least one, which is the calling thread
+static int reserve_workers(int wanted) {
+	int limit = get_worker_count();
+	int in_use = workers_in_use.load();
+	int n;
+
+	do {
+		n = limit - in_use;
+		if (n > wanted)
+			n = wanted;
+		if (n < 1)
+			n = 1;
+	} while (!workers_in_use.compare_exchange_weak(in_use, in_use + n));
+
+	return n;
+}
+
+struct Task_List {
+	void *data;
+	void (*func)(void*, int, int);
+	int n_workers;
+	std::unique_ptr<Task_Queue[]> queues;
+};
+
+struct Worker_Start {
+	Task_List *list;
+	int worker;
+};
+
+static void work_through_tasks(Task_List *list, int worker) {
+	Task_Queue& own = list->queues[worker];
+	int task = -1;
+
+	while (true) {
+		if (own.pop(task)) {
+			list->func(list->data, worker, task);
+			continue;
+		}
+
+		bool stole = false;
+		for (int i = 1; i < list->n_workers && !stole; i++) {
+			int victim = (worker + i) % list->n_workers;
+			stole = list->queues[victim].steal(task);
+		}
+
+		if (!stole)
+			break;
+
+		list->func(list->data, worker, task);
+	}
+}
+
+void run_tasks(void *data, void (*func)(void*, int, int), int n_tasks, int n_workers) {
+	if (n_tasks <= 0)
+		return;
+
+	if (n_workers > n_tasks)
+		n_workers = n_tasks;
+	if (n_workers < 1)
+		n_workers = 1;
+
+	n_workers = reserve_workers(n_workers);
+
+	Task_List list;
+	list.data = data;
+	list.func = func;
+	list.n_workers = n_workers;
+	list.queues = std::make_unique<Task_Queue[]>(n_workers);
+
+	for (int i = 0; i < n_workers; i++) {
+		int first = (int)((s64)n_tasks * i / n_workers);
+		int last = (int)((s64)n_tasks * (i+1) / n_workers);
+		list.queues[i].assign(first, last);
+	}
+
+	auto starts = std::make_unique<Worker_Start[]>(n_workers);
+	auto threads = std::make_unique<void*[]>(n_workers);
+
+	// the calling thread acts as worker 0
+	for (int i = 1; i < n_workers; i++) {
+		starts[i] = { .list = &list, .worker = i };
+		threads[i] = nullptr;
+
+		auto thread_func = [](void *ptr) {
+			auto ws = (Worker_Start*)ptr;
+			work_through_tasks(ws->list, ws->worker);
+			return (THREAD_RETURN_TYPE)0;
+		};
+		if (!start_thread(&threads[i], &starts[i], thread_func))
+			threads[i] = nullptr;
+	}
+
+	work_through_tasks(&list, 0);
+
+	for (int i = 1; i < n_workers; i++) {
+		if (threads[i])
+			join_thread(threads[i]);
+	}
+
+	workers_in_use -= n_workers;
+}
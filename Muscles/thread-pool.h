@@ -0,0 +1,24 @@
+#pragma once
+
+#include <atomic>
+
+#define MAX_WORKERS 64
+
+// Each worker is dealt a contiguous run of task indices up front, which it consumes from the front.
+// Once its own run is empty, it steals single tasks from the back of another worker's run,
+//  so one slow stretch of tasks (eg. a huge heap region) gets shared out instead of serialising the whole job.
+struct Task_Queue {
+	// low 32 bits = next task, high 32 bits = end of the run
+	std::atomic<u64> bounds = {0};
+
+	void assign(int first, int last);
+	bool pop(int& task);
+	bool steal(int& task);
+};
+
+int get_worker_count();
+
+// Calls func(data, worker, task) for every task in [0, n_tasks) and returns once they have all finished.
+// 'worker' is in [0, n_workers) and is never shared by two threads at the same time, so it can be used to index per-thread state.
+// Fewer than n_workers threads may be used if other calls to run_tasks() are already using up the worker budget.
+void run_tasks(void *data, void (*func)(void*, int, int), int n_tasks, int n_workers);
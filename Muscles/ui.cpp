@@ -1628,6 +1628,16 @@ void Number_Edit::draw_element(Renderer renderer, Camera& view, Rect_Int& back,
 	sdl_apply_texture(icon, r, nullptr, renderer);
 }
 
+void Progress_Bar::draw_element(Renderer renderer, Camera& view, Rect_Int& back, bool elem_hovered, bool box_hovered, bool focussed) {
+	sdl_draw_rect(back, default_color, renderer);
+
+	float f = fraction < 0 ? 0 : fraction > 1 ? 1 : fraction;
+	Rect_Int bar = back;
+	bar.w = (int)(back.w * f + 0.5);
+	if (bar.w > 0)
+		sdl_draw_rect(bar, sel_color, renderer);
+}
+
 void Scroll::set_maximum(double max, double span) {
 	maximum = max;
 
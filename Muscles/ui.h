@@ -14,7 +14,8 @@ enum Element_Type {
 	Elem_Hex_View,
 	Elem_Text_Editor,
 	Elem_Tabs,
-	Elem_Number_Edit
+	Elem_Number_Edit,
+	Elem_Progress_Bar
 };
 
 struct UI_Element;
@@ -535,6 +536,14 @@ struct Number_Edit : UI_Element {
 	void draw_element(Renderer renderer, Camera& view, Rect_Int& back, bool elem_hovered, bool box_hovered, bool focussed) override;
 };
 
+struct Progress_Bar : UI_Element {
+	Progress_Bar() : UI_Element(Elem_Progress_Bar) {}
+
+	float fraction = 0; // between 0 and 1
+
+	void draw_element(Renderer renderer, Camera& view, Rect_Int& back, bool elem_hovered, bool box_hovered, bool focussed) override;
+};
+
 struct Scroll : UI_Element {
 	Scroll() : UI_Element(Elem_Scroll) {}
 
@@ -683,7 +692,11 @@ enum MenuType {
 	MenuProcess,
 	MenuFile,
 	MenuValue,
-	MenuObject
+	MenuObject,
+	MenuPattern,
+	MenuText,
+	MenuPointer,
+	MenuGroup
 };
 
 struct Workspace;
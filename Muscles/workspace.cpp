@@ -50,6 +50,8 @@ void Workspace::close() {
 	delete rclick_menu.inactive_font;
 
 	for (auto& s : sources) {
+		close_pointer_index(*s);
+		close_heap_cache(*s);
 		close_source(*s);
 		delete s;
 	}
@@ -174,6 +176,8 @@ void Workspace::refresh_sources() {
 		if (s->timer % s->refresh_span_rate == 0) {
 			s->gather_data();
 		}
+		update_pointer_index(*s);
+		update_heap_cache(*s);
 		s->timer++;
 	}
 }